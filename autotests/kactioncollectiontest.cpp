@@ -1,10 +1,15 @@
 #include <QtTestWidgets>
 #include "kactioncollectiontest.h"
 #include <QAction>
+#include <QDomDocument>
+#include <QFile>
 #include <QPointer>
+#include <QSignalSpy>
+#include <QTemporaryDir>
 
 #include <ksharedconfig.h>
 #include <kstandardaction.h>
+#include <kxmlguiclient.h>
 
 void tst_KActionCollection::init()
 {
@@ -155,6 +160,156 @@ void tst_KActionCollection::readSettings()
     qDeleteAll(collection->actions());
 }
 
+void tst_KActionCollection::writeChangedSettings()
+{
+    KConfigGroup cfg = clearConfig();
+
+    const QList<QKeySequence> defaultShortcut = QList<QKeySequence>() << Qt::Key_A;
+    const QList<QKeySequence> otherShortcut = QList<QKeySequence>() << Qt::Key_B;
+
+    QAction *unchanged = new QAction(this);
+    collection->setDefaultShortcuts(unchanged, defaultShortcut);
+    unchanged->setShortcuts(otherShortcut);
+    collection->addAction(QStringLiteral("unchanged"), unchanged);
+
+    QAction *changed = new QAction(this);
+    collection->setDefaultShortcuts(changed, defaultShortcut);
+    collection->addAction(QStringLiteral("changed"), changed);
+
+    collection->writeSettings();
+    QCOMPARE(cfg.readEntry("unchanged", QString()), QKeySequence::listToString(otherShortcut));
+    QVERIFY(!cfg.hasKey("changed"));
+
+    // only the shortcuts which changed since are written again
+    cfg.writeEntry("unchanged", QStringLiteral("C"));
+    changed->setShortcuts(otherShortcut);
+    collection->writeSettings();
+    QCOMPARE(cfg.readEntry("unchanged", QString()), QStringLiteral("C"));
+    QCOMPARE(cfg.readEntry("changed", QString()), QKeySequence::listToString(otherShortcut));
+
+    // unless asked for all of them
+    collection->writeSettings(nullptr, true);
+    QCOMPARE(cfg.readEntry("unchanged", QString()), QKeySequence::listToString(otherShortcut));
+
+    // reading them doesn't make them dirty
+    cfg.writeEntry("unchanged", QStringLiteral("C"));
+    collection->readSettings();
+    QCOMPARE(unchanged->shortcuts(), QList<QKeySequence>() << Qt::Key_C);
+    collection->writeSettings();
+    QCOMPARE(cfg.readEntry("unchanged", QString()), QStringLiteral("C"));
+
+    qDeleteAll(collection->actions());
+}
+
+void tst_KActionCollection::writeChangedDefaultSettings()
+{
+    KConfigGroup cfg = clearConfig();
+
+    const QList<QKeySequence> defaultShortcut = QList<QKeySequence>() << Qt::Key_A;
+    const QList<QKeySequence> otherShortcut = QList<QKeySequence>() << Qt::Key_B;
+
+    QAction *action = new QAction(this);
+    collection->setDefaultShortcuts(action, defaultShortcut);
+    action->setShortcuts(otherShortcut);
+    collection->addAction(QStringLiteral("action"), action);
+
+    collection->writeSettings();
+    QCOMPARE(cfg.readEntry("action", QString()), QKeySequence::listToString(otherShortcut));
+
+    // e.g. after switching to another scheme: the shortcut is the same, but now it's the default
+    collection->setDefaultShortcuts(action, otherShortcut);
+    collection->writeSettings();
+    QVERIFY(!cfg.hasKey("action"));
+
+    qDeleteAll(collection->actions());
+}
+
+static QString shortcutInXMLFile(const QString &fileName, const QString &actionName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    QDomDocument doc;
+    doc.setContent(&file);
+    const QDomElement properties = doc.documentElement().firstChildElement(QStringLiteral("ActionProperties"));
+    for (QDomElement e = properties.firstChildElement(QStringLiteral("Action")); !e.isNull();
+            e = e.nextSiblingElement(QStringLiteral("Action"))) {
+        if (e.attribute(QStringLiteral("name")) == actionName) {
+            return e.attribute(QStringLiteral("shortcut"));
+        }
+    }
+    return QString();
+}
+
+static void setShortcutInXMLFile(const QString &fileName, const QString &actionName, const QString &shortcut)
+{
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QDomDocument doc;
+    QVERIFY(doc.setContent(&file));
+    file.close();
+    const QDomElement properties = doc.documentElement().firstChildElement(QStringLiteral("ActionProperties"));
+    for (QDomElement e = properties.firstChildElement(QStringLiteral("Action")); !e.isNull();
+            e = e.nextSiblingElement(QStringLiteral("Action"))) {
+        if (e.attribute(QStringLiteral("name")) == actionName) {
+            e.setAttribute(QStringLiteral("shortcut"), shortcut);
+        }
+    }
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(doc.toByteArray());
+}
+
+void tst_KActionCollection::writeChangedSettingsToXMLFile()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QStringLiteral("/kactioncollectiontestui.rc");
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+                   "<gui name=\"kactioncollectiontest\" version=\"1\">\n"
+                   "<ActionProperties>\n"
+                   "  <Action name=\"other\" shortcut=\"Ctrl+O\"/>\n"
+                   "</ActionProperties>\n"
+                   "</gui>\n");
+    }
+
+    // the shortcuts go to the local .rc file of the client rather than to KConfig
+    KXMLGUIClient client;
+    client.replaceXMLFile(fileName, fileName);
+    KActionCollection *clientCollection = client.actionCollection();
+
+    const QList<QKeySequence> defaultShortcut = QList<QKeySequence>() << Qt::Key_A;
+    const QList<QKeySequence> otherShortcut = QList<QKeySequence>() << Qt::Key_B;
+
+    QAction *first = clientCollection->addAction(QStringLiteral("first"));
+    clientCollection->setDefaultShortcuts(first, defaultShortcut);
+    first->setShortcuts(otherShortcut);
+    QAction *second = clientCollection->addAction(QStringLiteral("second"));
+    clientCollection->setDefaultShortcuts(second, defaultShortcut);
+
+    clientCollection->writeSettings();
+    QCOMPARE(shortcutInXMLFile(fileName, QStringLiteral("first")), QKeySequence::listToString(otherShortcut));
+    QVERIFY(shortcutInXMLFile(fileName, QStringLiteral("second")).isEmpty());
+    QCOMPARE(shortcutInXMLFile(fileName, QStringLiteral("other")), QStringLiteral("Ctrl+O"));
+
+    // only the entries of the shortcuts which changed since are patched
+    setShortcutInXMLFile(fileName, QStringLiteral("first"), QStringLiteral("C"));
+    second->setShortcuts(otherShortcut);
+    clientCollection->writeSettings();
+    QCOMPARE(shortcutInXMLFile(fileName, QStringLiteral("first")), QStringLiteral("C"));
+    QCOMPARE(shortcutInXMLFile(fileName, QStringLiteral("second")), QKeySequence::listToString(otherShortcut));
+    QCOMPARE(shortcutInXMLFile(fileName, QStringLiteral("other")), QStringLiteral("Ctrl+O"));
+
+    // an entry which became the same as a changed default is removed
+    clientCollection->setDefaultShortcuts(second, otherShortcut);
+    clientCollection->writeSettings();
+    QVERIFY(shortcutInXMLFile(fileName, QStringLiteral("second")).isEmpty());
+    QCOMPARE(shortcutInXMLFile(fileName, QStringLiteral("first")), QStringLiteral("C"));
+}
+
 void tst_KActionCollection::insertReplaces1()
 {
     QAction *a = new QAction(nullptr);
@@ -244,5 +399,153 @@ void tst_KActionCollection::implicitStandardActionInsertionUsingCut()
     QVERIFY(a == cut);
 }
 
+void tst_KActionCollection::order()
+{
+    QAction *a = collection->add<QAction>(QStringLiteral("a"));
+    QAction *b = collection->add<QAction>(QStringLiteral("b"));
+    QAction *c = collection->add<QAction>(QStringLiteral("c"));
+    QCOMPARE(collection->actions(), QList<QAction *>() << a << b << c);
+    QCOMPARE(collection->action(1), b);
+
+    collection->takeAction(b);
+    QCOMPARE(collection->actions(), QList<QAction *>() << a << c);
+
+    // adding an action again under another name moves it to the end
+    collection->addAction(QStringLiteral("a2"), a);
+    QCOMPARE(collection->actions(), QList<QAction *>() << c << a);
+    QVERIFY(!collection->action(QStringLiteral("a")));
+    QCOMPARE(collection->action(QStringLiteral("a2")), a);
+
+    collection->addAction(QStringLiteral("b"), b);
+    QCOMPARE(collection->actions(), QList<QAction *>() << c << a << b);
+    QCOMPARE(collection->count(), 3);
+}
+
+void tst_KActionCollection::renamedAction()
+{
+    QAction *a = collection->add<QAction>(QStringLiteral("a"));
+    a->setObjectName(QStringLiteral("renamed"));
+    QCOMPARE(collection->action(QStringLiteral("a")), a);
+
+    // the action is removed under the name it was added with
+    delete a;
+    QVERIFY(collection->isEmpty());
+    QVERIFY(!collection->action(QStringLiteral("a")));
+}
+
+void tst_KActionCollection::addActions()
+{
+    QWidget widget;
+    collection->addAssociatedWidget(&widget);
+
+    QAction *existing = collection->add<QAction>(QStringLiteral("existing"));
+    QAction *a = new QAction(this);
+    a->setObjectName(QStringLiteral("a"));
+    QAction *b = new QAction(this);
+    b->setObjectName(QStringLiteral("b"));
+    // replaces a
+    QAction *otherA = new QAction(this);
+    otherA->setObjectName(QStringLiteral("a"));
+
+    qRegisterMetaType<QList<QAction *> >();
+    QSignalSpy insertedSpy(collection, &KActionCollection::inserted);
+    QSignalSpy actionsInsertedSpy(collection, &KActionCollection::actionsInserted);
+    int actionsWhenInserted = -1;
+    connect(collection, &KActionCollection::inserted, this, [&]() {
+        if (actionsWhenInserted == -1) {
+            actionsWhenInserted = collection->count();
+        }
+    });
+
+    collection->addActions(QList<QAction *>() << a << existing << b << otherA);
+
+    QCOMPARE(collection->actions(), QList<QAction *>() << existing << b << otherA);
+    QCOMPARE(widget.actions(), QList<QAction *>() << existing << b << otherA);
+    QCOMPARE(insertedSpy.count(), 2);
+    QCOMPARE(actionsWhenInserted, 3);
+    QCOMPARE(actionsInsertedSpy.count(), 1);
+    QCOMPARE(actionsInsertedSpy.at(0).at(0).value<QList<QAction *> >(), QList<QAction *>() << b << otherA);
+
+    // nothing new
+    collection->addActions(QList<QAction *>() << b);
+    QCOMPARE(actionsInsertedSpy.count(), 1);
+
+    collection->removeAssociatedWidget(&widget);
+    delete a;
+}
+
+void tst_KActionCollection::removeActions()
+{
+    QPointer<QAction> a = collection->add<QAction>(QStringLiteral("a"));
+    QPointer<QAction> b = collection->add<QAction>(QStringLiteral("b"));
+    QPointer<QAction> c = collection->add<QAction>(QStringLiteral("c"));
+
+    collection->removeActions(QList<QAction *>() << a << c);
+
+    QVERIFY(a.isNull());
+    QVERIFY(c.isNull());
+    QCOMPARE(collection->actions(), QList<QAction *>() << b.data());
+}
+
+void tst_KActionCollection::benchmarkAddRemoveActions_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+}
+
+void tst_KActionCollection::benchmarkAddRemoveActions()
+{
+    QFETCH(int, count);
+
+    QList<QAction *> actions;
+    QStringList names;
+    for (int i = 0; i < count; ++i) {
+        // parented to the collection like the actions it creates itself
+        actions.append(new QAction(collection));
+        names.append(QStringLiteral("action_%1").arg(i));
+    }
+
+    QBENCHMARK {
+        for (int i = 0; i < count; ++i) {
+            collection->addAction(names.at(i), actions.at(i));
+        }
+        // rename half of them, then remove them in another order than they were added
+        for (int i = 0; i < count; i += 2) {
+            collection->addAction(names.at(i) + QStringLiteral("_renamed"), actions.at(i));
+        }
+        for (int i = count - 1; i >= 0; --i) {
+            collection->takeAction(actions.at(i));
+        }
+    }
+    QVERIFY(collection->isEmpty());
+
+    qDeleteAll(actions);
+}
+
+void tst_KActionCollection::benchmarkActionLookup_data()
+{
+    benchmarkAddRemoveActions_data();
+}
+
+void tst_KActionCollection::benchmarkActionLookup()
+{
+    QFETCH(int, count);
+
+    QStringList names;
+    for (int i = 0; i < count; ++i) {
+        names.append(QStringLiteral("action_%1").arg(i));
+        collection->add<QAction>(names.last());
+    }
+
+    QBENCHMARK {
+        Q_FOREACH (const QString &name, names) {
+            QVERIFY(collection->action(name));
+        }
+    }
+}
+
 QTEST_MAIN(tst_KActionCollection)
 
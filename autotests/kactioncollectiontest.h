@@ -19,11 +19,22 @@ private Q_SLOTS:
     void take();
     void writeSettings();
     void readSettings();
+    void writeChangedSettings();
+    void writeChangedDefaultSettings();
+    void writeChangedSettingsToXMLFile();
     void insertReplaces1();
     void insertReplaces2();
     void testSetShortcuts();
     void implicitStandardActionInsertionUsingCreate();
     void implicitStandardActionInsertionUsingCut();
+    void order();
+    void renamedAction();
+    void addActions();
+    void removeActions();
+    void benchmarkAddRemoveActions_data();
+    void benchmarkAddRemoveActions();
+    void benchmarkActionLookup_data();
+    void benchmarkActionLookup();
 
 private:
     KConfigGroup clearConfig();
@@ -0,0 +1,324 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <QtTestWidgets>
+#include <QAction>
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusMetaType>
+#include <QDBusObjectPath>
+#include <QDBusVirtualObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <kactioncollection.h>
+#include <kconfig.h>
+#include <kconfiggroup.h>
+#include <kglobalaccel.h>
+
+// What org.kde.kglobalaccel.Component.allShortcutInfos() returns, in the layout of KGlobalShortcutInfo
+struct MockShortcutInfo {
+    QString uniqueName;
+    QString friendlyName;
+    QString componentUniqueName;
+    QString componentFriendlyName;
+    QString contextUniqueName;
+    QString contextFriendlyName;
+    QList<int> keys;
+    QList<int> defaultKeys;
+};
+Q_DECLARE_METATYPE(MockShortcutInfo)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const MockShortcutInfo &info)
+{
+    argument.beginStructure();
+    argument << info.uniqueName << info.friendlyName
+             << info.componentUniqueName << info.componentFriendlyName
+             << info.contextUniqueName << info.contextFriendlyName
+             << info.keys << info.defaultKeys;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, MockShortcutInfo &info)
+{
+    argument.beginStructure();
+    argument >> info.uniqueName >> info.friendlyName
+             >> info.componentUniqueName >> info.componentFriendlyName
+             >> info.contextUniqueName >> info.contextFriendlyName
+             >> info.keys >> info.defaultKeys;
+    argument.endStructure();
+    return argument;
+}
+
+/*
+ * Stands in for the kglobalaccel daemon: keeps the shortcuts it's told about and
+ * counts the calls it gets. It runs in a thread of its own, since the calls of
+ * KGlobalAccel block.
+ */
+class MockGlobalAccel : public QDBusVirtualObject
+{
+public:
+    // SetShortcutFlag of kglobalaccel
+    enum {
+        NoAutoloading = 4,
+        IsDefault = 8
+    };
+
+    QString introspect(const QString &path) const override
+    {
+        Q_UNUSED(path);
+        return QString();
+    }
+
+    bool handleMessage(const QDBusMessage &message, const QDBusConnection &connection) override
+    {
+        const QString method = message.member();
+        const QList<QVariant> args = message.arguments();
+        QDBusConnection bus(connection);
+
+        if (message.interface() == QLatin1String("org.kde.KGlobalAccel")) {
+            if (method == QLatin1String("doRegister")) {
+                const QStringList actionId = args.value(0).toStringList();
+                count(method, actionId.value(1));
+                m_shortcuts[actionId.value(0)][actionId.value(1)];
+                bus.send(message.createReply());
+                return true;
+            }
+            if (method == QLatin1String("setShortcut")) {
+                const QStringList actionId = args.value(0).toStringList();
+                count(method, actionId.value(1));
+                QList<int> keys = qdbus_cast<QList<int> >(args.value(1));
+                const uint flags = args.value(2).toUInt();
+                QPair<QList<int>, QList<int> > &shortcut = m_shortcuts[actionId.value(0)][actionId.value(1)];
+                if (flags & IsDefault) {
+                    shortcut.second = keys;
+                } else if (!(flags & NoAutoloading) && !shortcut.first.isEmpty()) {
+                    keys = shortcut.first;
+                } else {
+                    shortcut.first = keys;
+                }
+                bus.send(message.createReply(QVariant::fromValue(keys)));
+                return true;
+            }
+            if (method == QLatin1String("getComponent")) {
+                const QString component = args.value(0).toString();
+                count(method, component);
+                if (!m_shortcuts.contains(component)) {
+                    bus.send(message.createErrorReply(QStringLiteral("org.kde.kglobalaccel.NoSuchComponent"), component));
+                } else {
+                    bus.send(message.createReply(QVariant::fromValue(QDBusObjectPath(componentPath(component)))));
+                }
+                return true;
+            }
+        } else if (message.interface() == QLatin1String("org.kde.kglobalaccel.Component")
+                   && method == QLatin1String("allShortcutInfos")) {
+            count(method, message.path());
+            QList<MockShortcutInfo> infos;
+            for (auto component = m_shortcuts.constBegin(); component != m_shortcuts.constEnd(); ++component) {
+                if (componentPath(component.key()) != message.path()) {
+                    continue;
+                }
+                for (auto it = component->constBegin(); it != component->constEnd(); ++it) {
+                    MockShortcutInfo info;
+                    info.uniqueName = it.key();
+                    info.componentUniqueName = component.key();
+                    info.contextUniqueName = QStringLiteral("default");
+                    info.keys = it->first;
+                    info.defaultKeys = it->second;
+                    infos.append(info);
+                }
+            }
+            bus.send(message.createReply(QVariant::fromValue(infos)));
+            return true;
+        }
+
+        count(method, QString());
+        bus.send(message.createErrorReply(QDBusError::UnknownMethod, method));
+        return true;
+    }
+
+    int calls(const QString &method, const QString &argument = QString()) const
+    {
+        QMutexLocker locker(&m_mutex);
+        return argument.isEmpty() ? m_calls.value(method) : m_callsFor.value(method + QLatin1Char('/') + argument);
+    }
+
+    int totalCalls() const
+    {
+        QMutexLocker locker(&m_mutex);
+        int total = 0;
+        Q_FOREACH (int count, m_calls) {
+            total += count;
+        }
+        return total;
+    }
+
+    void resetCalls()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_calls.clear();
+        m_callsFor.clear();
+    }
+
+private:
+    static QString componentPath(const QString &component)
+    {
+        QString path = component;
+        for (int i = 0; i < path.length(); ++i) {
+            if (!path.at(i).isLetterOrNumber() || path.at(i).unicode() > 127) {
+                path[i] = QLatin1Char('_');
+            }
+        }
+        return QStringLiteral("/component/") + path;
+    }
+
+    void count(const QString &method, const QString &argument)
+    {
+        QMutexLocker locker(&m_mutex);
+        ++m_calls[method];
+        ++m_callsFor[method + QLatin1Char('/') + argument];
+    }
+
+    mutable QMutex m_mutex;
+    QHash<QString, int> m_calls;
+    QHash<QString, int> m_callsFor;
+    // component -> action -> (active keys, default keys), only used in the thread of the mock
+    QHash<QString, QHash<QString, QPair<QList<int>, QList<int> > > > m_shortcuts;
+};
+
+class KGlobalShortcutsTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void importGlobalShortcuts();
+    void exportGlobalShortcuts();
+
+private:
+    QThread m_thread;
+    MockGlobalAccel *m_mock = nullptr;
+    KActionCollection *m_collection = nullptr;
+};
+
+static const char s_mockConnection[] = "kglobalaccel-mock";
+
+void KGlobalShortcutsTest::initTestCase()
+{
+    qDBusRegisterMetaType<QList<int> >();
+    qDBusRegisterMetaType<MockShortcutInfo>();
+    qDBusRegisterMetaType<QList<MockShortcutInfo> >();
+
+    m_mock = new MockGlobalAccel;
+    m_mock->moveToThread(&m_thread);
+    m_thread.start();
+
+    // a connection of its own, as if it was another process; this must happen
+    // before KGlobalAccel is used, or it would register everything again
+    QDBusConnection bus = QDBusConnection::connectToBus(QDBusConnection::SessionBus, QLatin1String(s_mockConnection));
+    if (!bus.isConnected()) {
+        QSKIP("No session bus");
+    }
+    QVERIFY(bus.registerVirtualObject(QStringLiteral("/kglobalaccel"), m_mock));
+    QVERIFY(bus.registerVirtualObject(QStringLiteral("/component"), m_mock, QDBusConnection::SubPathsInclusive));
+    if (!bus.registerService(QStringLiteral("org.kde.kglobalaccel"))) {
+        QSKIP("kglobalaccel is running, this test needs a private session bus (dbus-run-session)");
+    }
+
+    m_collection = new KActionCollection(static_cast<QObject *>(nullptr), QStringLiteral("kxmlgui_globalshortcutstest"));
+    QAction *unchanged = m_collection->addAction(QStringLiteral("unchanged"));
+    QAction *changed = m_collection->addAction(QStringLiteral("changed"));
+    QAction *reset = m_collection->addAction(QStringLiteral("reset"));
+    KGlobalAccel::setGlobalShortcut(unchanged, QKeySequence(QStringLiteral("Meta+F1")));
+    KGlobalAccel::setGlobalShortcut(changed, QKeySequence(QStringLiteral("Meta+F2")));
+    KGlobalAccel::setGlobalShortcut(reset, QKeySequence(QStringLiteral("Meta+F3")));
+    KGlobalAccel::self()->setShortcut(reset, QList<QKeySequence>() << QKeySequence(QStringLiteral("Meta+F4")),
+                                      KGlobalAccel::NoAutoloading);
+    QCOMPARE(KGlobalAccel::self()->shortcut(reset), QList<QKeySequence>() << QKeySequence(QStringLiteral("Meta+F4")));
+}
+
+void KGlobalShortcutsTest::cleanupTestCase()
+{
+    delete m_collection;
+    {
+        QDBusConnection bus(QLatin1String(s_mockConnection));
+        bus.unregisterService(QStringLiteral("org.kde.kglobalaccel"));
+        bus.unregisterObject(QStringLiteral("/kglobalaccel"));
+        bus.unregisterObject(QStringLiteral("/component"), QDBusConnection::UnregisterTree);
+    }
+    QDBusConnection::disconnectFromBus(QLatin1String(s_mockConnection));
+    m_thread.quit();
+    m_thread.wait();
+    delete m_mock;
+}
+
+void KGlobalShortcutsTest::importGlobalShortcuts()
+{
+    KConfig config(QString(), KConfig::SimpleConfig);
+    KConfigGroup group(&config, "Global Shortcuts");
+    group.writeEntry("unchanged", QStringLiteral("Meta+F1"));
+    group.writeEntry("changed", QStringLiteral("Meta+F5"));
+    // no entry for "reset", it gets its default back
+
+    // the shortcuts kglobalaccel has are fetched at once, and only the changed ones are set
+    m_mock->resetCalls();
+    m_collection->importGlobalShortcuts(&group);
+    QCOMPARE(m_mock->calls(QStringLiteral("getComponent")), 1);
+    QCOMPARE(m_mock->calls(QStringLiteral("allShortcutInfos")), 1);
+    QCOMPARE(m_mock->calls(QStringLiteral("setShortcut"), QStringLiteral("unchanged")), 0);
+    QVERIFY(m_mock->calls(QStringLiteral("setShortcut"), QStringLiteral("changed")) > 0);
+    QVERIFY(m_mock->calls(QStringLiteral("setShortcut"), QStringLiteral("reset")) > 0);
+    QCOMPARE(m_mock->calls(QStringLiteral("doRegister")), 0);
+
+    QAction *changed = m_collection->action(QStringLiteral("changed"));
+    QAction *reset = m_collection->action(QStringLiteral("reset"));
+    QCOMPARE(KGlobalAccel::self()->shortcut(changed), QList<QKeySequence>() << QKeySequence(QStringLiteral("Meta+F5")));
+    QCOMPARE(KGlobalAccel::self()->shortcut(reset), QList<QKeySequence>() << QKeySequence(QStringLiteral("Meta+F3")));
+
+    // nothing left to change
+    m_mock->resetCalls();
+    m_collection->importGlobalShortcuts(&group);
+    QCOMPARE(m_mock->calls(QStringLiteral("getComponent")), 1);
+    QCOMPARE(m_mock->calls(QStringLiteral("allShortcutInfos")), 1);
+    QCOMPARE(m_mock->calls(QStringLiteral("setShortcut")), 0);
+}
+
+void KGlobalShortcutsTest::exportGlobalShortcuts()
+{
+    KConfig config(QString(), KConfig::SimpleConfig);
+    KConfigGroup group(&config, "Global Shortcuts");
+    group.writeEntry("unchanged", QStringLiteral("Meta+F1"));
+
+    // everything needed is known in this process already
+    m_mock->resetCalls();
+    m_collection->exportGlobalShortcuts(&group);
+    QCOMPARE(m_mock->totalCalls(), 0);
+
+    QCOMPARE(group.readEntry("changed", QString()), QStringLiteral("Meta+F5"));
+    // same as the defaults
+    QVERIFY(!group.hasKey("unchanged"));
+    QVERIFY(!group.hasKey("reset"));
+}
+
+QTEST_MAIN(KGlobalShortcutsTest)
+
+#include "kglobalshortcutstest.moc"
@@ -27,6 +27,11 @@
 #include <QDialogButtonBox>
 #include <QShowEvent>
 #include <QMenuBar>
+#include <QPointer>
+#include <QSignalSpy>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QPushButton>
 #include <QDebug>
 
@@ -36,8 +41,12 @@
 #include <kconfiggroup.h>
 #include <kxmlguibuilder.h>
 #include <kxmlguiclient.h>
+#include <kxmlguiprofiler_p.h> // exported for this test
 #include <kxmlguiversionhandler.cpp> // it's not exported, so we need to include the code here
+#include <kxmlguicache.cpp> // same here
+#include <kxmlguifileindex.cpp> // same here
 #include <QDir>
+#include <QFileInfo>
 
 QTEST_MAIN(KXmlGui_UnitTest)
 
@@ -151,6 +160,32 @@ void KXmlGui_UnitTest::testFindVersionNumber()
     QCOMPARE(KXmlGuiVersionHandler::findVersionNumber(xml), version);
 }
 
+void KXmlGui_UnitTest::testFindVersionNumberInFile()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    createXmlFile(file, 3, AddToolBars);
+    file.close();
+    QCOMPARE(KXmlGuiVersionHandler::findVersionNumberInFile(file.fileName()), QStringLiteral("3"));
+
+    // the cached version is dropped when the file changes
+    QVERIFY(file.open());
+    file.resize(0);
+    createXmlFile(file, 12, NoFlags);
+    file.close();
+    QCOMPARE(KXmlGuiVersionHandler::findVersionNumberInFile(file.fileName()), QStringLiteral("12"));
+
+    // a preamble longer than the header which is read first
+    QTemporaryFile longFile;
+    QVERIFY(longFile.open());
+    longFile.write("<!DOCTYPE gui>\n<!-- " + QByteArray(10000, 'x') + " -->\n");
+    createXmlFile(longFile, 7, NoFlags);
+    longFile.close();
+    QCOMPARE(KXmlGuiVersionHandler::findVersionNumberInFile(longFile.fileName()), QStringLiteral("7"));
+
+    QVERIFY(KXmlGuiVersionHandler::findVersionNumberInFile(QStringLiteral("/does/not/exist.rc")).isEmpty());
+}
+
 void KXmlGui_UnitTest::testVersionHandlerSameVersion()
 {
     // This emulates the case where the user has modified stuff locally
@@ -181,6 +216,8 @@ void KXmlGui_UnitTest::testVersionHandlerSameVersion()
     // Check that the toolbars modified by the user were kept
     QVERIFY(finalDoc.contains(QStringLiteral("<Action name=\"home\"")));
 
+    QVERIFY(versionHandler.mergedDocument().isNull());
+
     QVERIFY(userFile.open());
     const QString userFileContents = QString::fromUtf8(userFile.readAll());
     QCOMPARE(finalDoc, userFileContents);
@@ -281,6 +318,16 @@ void KXmlGui_UnitTest::testVersionHandlerNewVersionUserChanges()
     QVERIFY(finalDoc.contains(QStringLiteral("<Action name=\"file_open\"")));
     // Check that the toolbars modified by the user were kept
     QVERIFY(finalDoc.contains(QStringLiteral("<Action name=\"home\"")));
+
+    // The merged document is available without parsing it again
+    QVERIFY(!versionHandler.mergedDocument().isNull());
+    QCOMPARE(versionHandler.mergedDocument().documentElement().attribute(QStringLiteral("version")), QStringLiteral("5"));
+
+    // and the local file was updated in the background, reading it waits for that
+    QCOMPARE(QString::fromUtf8(KXMLGUIFactory::readConfigFileData(fileV2.fileName())), finalDoc);
+    KXmlGuiVersionHandler::waitForPendingWrites();
+    QVERIFY(fileV2.open(QIODevice::ReadOnly));
+    QCOMPARE(QString::fromUtf8(fileV2.readAll()), finalDoc);
 }
 
 static QStringList collectMenuNames(KXMLGUIFactory &factory)
@@ -504,6 +551,367 @@ void KXmlGui_UnitTest::testPartMergingSettings() // #252911
     factory.removeClient(&hostClient);
 }
 
+void KXmlGui_UnitTest::testReplaceClient()
+{
+    const QByteArray hostXml =
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui version=\"1\" name=\"host\" >\n"
+        "<MenuBar>\n"
+        " <Menu name=\"file\"><text>&amp;File</text>\n"
+        "  <Action name=\"file_quit\"/>\n"
+        " </Menu>\n"
+        " <Merge/>\n"
+        "</MenuBar>\n"
+        "</gui>\n";
+    const QByteArray part1Xml =
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui version=\"1\" name=\"part1\" >\n"
+        "<MenuBar>\n"
+        " <Menu name=\"edit\"><text>&amp;Edit</text>\n"
+        "  <Action name=\"edit_copy\"/>\n"
+        "  <Action name=\"part1_action\"/>\n"
+        " </Menu>\n"
+        " <Menu name=\"view\"><text>&amp;View</text>\n"
+        "  <Action name=\"view_zoom\"/>\n"
+        " </Menu>\n"
+        "</MenuBar>\n"
+        "<ToolBar name=\"partToolBar\"><text>Part Toolbar</text>\n"
+        "  <Action name=\"edit_copy\"/>\n"
+        "</ToolBar>\n"
+        "</gui>\n";
+    const QByteArray part2Xml =
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui version=\"1\" name=\"part2\" >\n"
+        "<MenuBar>\n"
+        " <Menu name=\"edit\"><text>&amp;Edit</text>\n"
+        "  <Action name=\"edit_copy\"/>\n"
+        "  <Action name=\"part2_action\"/>\n"
+        " </Menu>\n"
+        " <Menu name=\"view\"><text>&amp;Display</text>\n"
+        "  <Action name=\"view_zoom\"/>\n"
+        " </Menu>\n"
+        " <Menu name=\"tools\"><text>&amp;Tools</text>\n"
+        "  <Action name=\"tools_spelling\"/>\n"
+        " </Menu>\n"
+        "</MenuBar>\n"
+        "<ToolBar name=\"partToolBar\"><text>Part Toolbar</text>\n"
+        "  <Action name=\"part2_action\"/>\n"
+        "</ToolBar>\n"
+        "</gui>\n";
+
+    TestGuiClient hostClient;
+    hostClient.createActions(QStringList() << QStringLiteral("file_quit"));
+    hostClient.createGUI(hostXml);
+    TestGuiClient part1(part1Xml);
+    part1.createActions(QStringList() << QStringLiteral("edit_copy") << QStringLiteral("part1_action") << QStringLiteral("view_zoom"));
+    TestGuiClient part2(part2Xml);
+    part2.createActions(QStringList() << QStringLiteral("edit_copy") << QStringLiteral("part2_action")
+                        << QStringLiteral("view_zoom") << QStringLiteral("tools_spelling"));
+
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+    factory.addClient(&hostClient);
+    factory.addClient(&part1);
+
+    QPointer<QWidget> editMenu = factory.container(QStringLiteral("edit"), &part1);
+    QPointer<QWidget> viewMenu = factory.container(QStringLiteral("view"), &part1);
+    QPointer<QWidget> partToolBar = factory.container(QStringLiteral("partToolBar"), &part1);
+    QVERIFY(editMenu);
+    QVERIFY(viewMenu);
+    QVERIFY(partToolBar);
+
+    QSignalSpy makingChangesSpy(&factory, SIGNAL(makingChanges(bool)));
+    factory.replaceClient(&part1, &part2);
+    QCOMPARE(makingChangesSpy.count(), 2);
+
+    QCOMPARE(factory.clients(), QList<KXMLGUIClient *>() << &hostClient << &part2);
+    QVERIFY(!part1.factory());
+    QCOMPARE(part2.factory(), &factory);
+
+    // same definition: kept and now owned by part2
+    QVERIFY(editMenu);
+    QCOMPARE(factory.container(QStringLiteral("edit"), &part2), editMenu.data());
+    checkActions(editMenu->actions(), QStringList() << QStringLiteral("edit_copy") << QStringLiteral("part2_action"));
+    QVERIFY(partToolBar);
+    QCOMPARE(factory.container(QStringLiteral("partToolBar"), &part2), partToolBar.data());
+    checkActions(partToolBar->actions(), QStringList() << QStringLiteral("part2_action"));
+
+    // different text: recreated
+    QVERIFY(!viewMenu);
+    QMenu *newViewMenu = qobject_cast<QMenu *>(factory.container(QStringLiteral("view"), &part2));
+    QVERIFY(newViewMenu);
+    QCOMPARE(newViewMenu->menuAction()->text(), QStringLiteral("&Display"));
+    QVERIFY(factory.container(QStringLiteral("tools"), &part2));
+
+    const QList<QAction *> menuBarActions = mainWindow.menuBar()->actions();
+    QStringList menuNames;
+    Q_FOREACH (QAction *action, menuBarActions) {
+        menuNames << action->menu()->objectName();
+    }
+    QCOMPARE(menuNames, QStringList() << QStringLiteral("file") << QStringLiteral("edit")
+                                      << QStringLiteral("view") << QStringLiteral("tools"));
+
+    // the reused containers belong to part2 now
+    factory.removeClient(&part2);
+    QVERIFY(!editMenu);
+    QVERIFY(!partToolBar);
+    QCOMPARE(mainWindow.menuBar()->actions().count(), 1);
+}
+
+void KXmlGui_UnitTest::testContainerLookup()
+{
+    const QByteArray hostXml =
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui version=\"1\" name=\"host\" >\n"
+        "<MenuBar>\n"
+        " <Menu name=\"file\"><text>&amp;File</text>\n"
+        "  <Action name=\"file_quit\"/>\n"
+        " </Menu>\n"
+        " <Merge/>\n"
+        "</MenuBar>\n"
+        "<ToolBar name=\"mainToolBar\"><text>Main Toolbar</text>\n"
+        "  <Action name=\"file_quit\"/>\n"
+        "</ToolBar>\n"
+        "</gui>\n";
+    const QByteArray partXml =
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui version=\"1\" name=\"part\" >\n"
+        "<MenuBar>\n"
+        " <Menu name=\"edit\"><text>&amp;Edit</text>\n"
+        "  <Action name=\"edit_copy\"/>\n"
+        "  <Menu name=\"sub\"><text>&amp;Sub</text>\n"
+        "   <Action name=\"edit_paste\"/>\n"
+        "  </Menu>\n"
+        " </Menu>\n"
+        "</MenuBar>\n"
+        "<ToolBar name=\"partToolBar\"><text>Part Toolbar</text>\n"
+        "  <Action name=\"edit_copy\"/>\n"
+        "</ToolBar>\n"
+        "</gui>\n";
+
+    TestGuiClient hostClient;
+    hostClient.createActions(QStringList() << QStringLiteral("file_quit"));
+    hostClient.createGUI(hostXml);
+    TestGuiClient part(partXml);
+    part.createActions(QStringList() << QStringLiteral("edit_copy") << QStringLiteral("edit_paste"));
+
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+    factory.addClient(&hostClient);
+    factory.addClient(&part);
+
+    QWidget *editMenu = factory.container(QStringLiteral("edit"), &part);
+    QVERIFY(editMenu);
+    QCOMPARE(factory.container(QStringLiteral("edit"), nullptr), editMenu);
+    QVERIFY(!factory.container(QStringLiteral("edit"), &hostClient));
+    QWidget *subMenu = factory.container(QStringLiteral("sub"), &part);
+    QVERIFY(subMenu);
+    QCOMPARE(subMenu->parentWidget(), editMenu);
+    QCOMPARE(factory.container(QStringLiteral("MenuBar"), nullptr, true), mainWindow.menuBar());
+
+    // several containers with the same tag: the first one in the tree wins
+    QWidget *mainToolBar = factory.container(QStringLiteral("mainToolBar"), &hostClient);
+    QVERIFY(mainToolBar);
+    QCOMPARE(factory.container(QStringLiteral("ToolBar"), nullptr, true), mainToolBar);
+    QCOMPARE(factory.container(QStringLiteral("ToolBar"), &part, true),
+             factory.container(QStringLiteral("partToolBar"), &part));
+    QCOMPARE(factory.containers(QStringLiteral("ToolBar")).count(), 2);
+
+    factory.removeClient(&part);
+    QVERIFY(!factory.container(QStringLiteral("edit"), nullptr));
+    QVERIFY(!factory.container(QStringLiteral("sub"), nullptr));
+    QVERIFY(!factory.container(QStringLiteral("partToolBar"), nullptr));
+    QCOMPARE(factory.container(QStringLiteral("ToolBar"), nullptr, true), mainToolBar);
+
+    factory.addClient(&part);
+    QVERIFY(factory.container(QStringLiteral("edit"), &part));
+    QVERIFY(factory.container(QStringLiteral("sub"), &part));
+    QCOMPARE(factory.containers(QStringLiteral("ToolBar")).count(), 2);
+}
+
+void KXmlGui_UnitTest::testBatch()
+{
+    const QByteArray hostXml =
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui version=\"1\" name=\"host\" >\n"
+        "<MenuBar>\n"
+        " <Menu name=\"file\"><text>&amp;File</text>\n"
+        "  <Action name=\"file_quit\"/>\n"
+        " </Menu>\n"
+        " <Merge/>\n"
+        "</MenuBar>\n"
+        "</gui>\n";
+    const QByteArray pluginXml =
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui version=\"1\" name=\"plugin\" >\n"
+        "<MenuBar>\n"
+        " <Menu name=\"tools\"><text>&amp;Tools</text>\n"
+        "  <Action name=\"plugin_action\"/>\n"
+        " </Menu>\n"
+        "</MenuBar>\n"
+        "</gui>\n";
+
+    TestGuiClient hostClient;
+    hostClient.createActions(QStringList() << QStringLiteral("file_quit"));
+    hostClient.createGUI(hostXml);
+    TestGuiClient plugin1(pluginXml);
+    plugin1.createActions(QStringList() << QStringLiteral("plugin_action"));
+    TestGuiClient plugin2(QByteArray(pluginXml).replace("name=\"plugin\"", "name=\"plugin2\""));
+    plugin2.createActions(QStringList() << QStringLiteral("plugin_action"));
+
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+
+    QSignalSpy makingChangesSpy(&factory, SIGNAL(makingChanges(bool)));
+    QSignalSpy clientAddedSpy(&factory, SIGNAL(clientAdded(KXMLGUIClient*)));
+    QList<QList<KXMLGUIClient *> > addedClients;
+    connect(&factory, &KXMLGUIFactory::clientsAdded, this, [&addedClients](const QList<KXMLGUIClient *> &clients) {
+        addedClients.append(clients);
+    });
+    QList<QList<KXMLGUIClient *> > removedClients;
+    connect(&factory, &KXMLGUIFactory::clientsRemoved, this, [&removedClients](const QList<KXMLGUIClient *> &clients) {
+        removedClients.append(clients);
+    });
+
+    {
+        KXMLGUIFactory::Batch batch(&factory);
+        QCOMPARE(makingChangesSpy.count(), 1);
+        QVERIFY(!mainWindow.updatesEnabled());
+        factory.addClient(&hostClient);
+        factory.addClient(&plugin1);
+        factory.addClient(&plugin2);
+        QCOMPARE(clientAddedSpy.count(), 3);
+        QVERIFY(addedClients.isEmpty());
+    }
+    QVERIFY(mainWindow.updatesEnabled());
+    QCOMPARE(makingChangesSpy.count(), 2);
+    QVERIFY(makingChangesSpy.at(0).at(0).toBool());
+    QVERIFY(!makingChangesSpy.at(1).at(0).toBool());
+    QCOMPARE(addedClients.count(), 1);
+    QCOMPARE(addedClients.at(0), QList<KXMLGUIClient *>() << &hostClient << &plugin1 << &plugin2);
+    QCOMPARE(factory.clients(), addedClients.at(0));
+    checkActions(factory.container(QStringLiteral("tools"), &plugin1)->actions(),
+                 QStringList() << QStringLiteral("plugin_action") << QStringLiteral("plugin_action"));
+
+    // outside of a batch, each call is a change of its own
+    makingChangesSpy.clear();
+    factory.removeClient(&plugin2);
+    QCOMPARE(makingChangesSpy.count(), 2);
+    QCOMPARE(removedClients.count(), 1);
+    QCOMPARE(removedClients.at(0), QList<KXMLGUIClient *>() << &plugin2);
+
+    // nested batches
+    makingChangesSpy.clear();
+    removedClients.clear();
+    factory.beginBatch();
+    factory.beginBatch();
+    factory.removeClient(&plugin1);
+    factory.endBatch();
+    QVERIFY(removedClients.isEmpty());
+    QVERIFY(!mainWindow.updatesEnabled());
+    factory.removeClient(&hostClient);
+    factory.endBatch();
+    QVERIFY(mainWindow.updatesEnabled());
+    QCOMPARE(makingChangesSpy.count(), 2);
+    QCOMPARE(removedClients.count(), 1);
+    QCOMPARE(removedClients.at(0), QList<KXMLGUIClient *>() << &plugin1 << &hostClient);
+    QVERIFY(factory.clients().isEmpty());
+
+    // clients added and removed, or deleted, during a batch aren't reported
+    addedClients.clear();
+    removedClients.clear();
+    {
+        KXMLGUIFactory::Batch batch(&factory);
+        factory.addClient(&hostClient);
+        factory.addClient(&plugin1);
+        factory.removeClient(&plugin1);
+        // without any GUI, so that deleting it while added is safe
+        TestGuiClient *deletedPlugin = new TestGuiClient("<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+                                                         "<gui version=\"1\" name=\"deleted\" />\n");
+        factory.addClient(deletedPlugin);
+        delete deletedPlugin;
+    }
+    QCOMPARE(addedClients.count(), 1);
+    QCOMPARE(addedClients.at(0), QList<KXMLGUIClient *>() << &hostClient);
+    QVERIFY(removedClients.isEmpty());
+
+    // removed and added again: no change either
+    {
+        KXMLGUIFactory::Batch batch(&factory);
+        factory.removeClient(&hostClient);
+        factory.addClient(&hostClient);
+    }
+    QCOMPARE(addedClients.count(), 1);
+    QVERIFY(removedClients.isEmpty());
+    factory.removeClient(&hostClient);
+}
+
+static QStringList childElementNames(const QDomElement &parent)
+{
+    QStringList names;
+    for (QDomElement e = parent.firstChildElement(); !e.isNull(); e = e.nextSiblingElement()) {
+        if (e.tagName() != QLatin1String("text")) {
+            names.append(e.attribute(QStringLiteral("name")));
+        }
+    }
+    return names;
+}
+
+void KXmlGui_UnitTest::testMergeXML()
+{
+    const QByteArray baseXml =
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui version=\"1\" name=\"base\" >\n"
+        "<MenuBar>\n"
+        "  <Menu name=\"file\"><text>File</text>\n"
+        "    <Action name=\"file_new\"/>\n"
+        "    <MergeLocal/>\n"
+        "    <Action name=\"file_quit\"/>\n"
+        "  </Menu>\n"
+        "  <Menu name=\"edit\"><text>Edit</text>\n"
+        "    <Action name=\"edit_undo\"/>\n"
+        "  </Menu>\n"
+        "  <Menu name=\"empty\"><text>Empty</text>\n"
+        "    <Action name=\"not_implemented\"/>\n"
+        "  </Menu>\n"
+        "</MenuBar>\n"
+        "</gui>\n";
+    const QByteArray additiveXml =
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui version=\"1\" name=\"app\" >\n"
+        "<MenuBar>\n"
+        "  <menu name=\"file\">\n"
+        "    <Action name=\"file_open\"/>\n"
+        "  </menu>\n"
+        "  <Menu name=\"edit\">\n"
+        "    <Action name=\"edit_copy\"/>\n"
+        "  </Menu>\n"
+        "  <Menu name=\"tools\"><text>Tools</text>\n"
+        "    <Action name=\"tools_run\"/>\n"
+        "  </Menu>\n"
+        "</MenuBar>\n"
+        "</gui>\n";
+
+    TestGuiClient client(baseXml);
+    client.createActions(QStringList() << QStringLiteral("file_new") << QStringLiteral("file_open") << QStringLiteral("file_quit")
+                         << QStringLiteral("edit_undo") << QStringLiteral("edit_copy") << QStringLiteral("tools_run"));
+    client.createGUI(additiveXml);
+
+    const QDomDocument doc = client.domDocument();
+    const QDomElement menuBar = doc.documentElement().firstChildElement(QStringLiteral("MenuBar"));
+    QCOMPARE(childElementNames(menuBar), QStringList() << QStringLiteral("file") << QStringLiteral("edit") << QStringLiteral("tools"));
+    QDomElement menu = menuBar.firstChildElement();
+    QCOMPARE(childElementNames(menu), QStringList() << QStringLiteral("file_new") << QStringLiteral("file_open") << QStringLiteral("file_quit"));
+    menu = menu.nextSiblingElement();
+    QCOMPARE(childElementNames(menu), QStringList() << QStringLiteral("edit_undo") << QStringLiteral("edit_copy"));
+
+    // merging doesn't leave markers behind
+    QVERIFY(!doc.toString().contains(QStringLiteral("alreadyVisited")));
+}
+
 void KXmlGui_UnitTest::testUiStandardsMerging_data()
 {
     QTest::addColumn<QByteArray>("xml");
@@ -704,6 +1112,241 @@ void KXmlGui_UnitTest::testActionListAndSeparator()
     factory.removeClient(&client);
 }
 
+// Counts the actions added to and removed from a widget
+class ActionEventCounter : public QObject
+{
+public:
+    explicit ActionEventCounter(QWidget *widget)
+        : added(0), removed(0)
+    {
+        widget->installEventFilter(this);
+    }
+    bool eventFilter(QObject *, QEvent *event) override
+    {
+        if (event->type() == QEvent::ActionAdded) {
+            ++added;
+        } else if (event->type() == QEvent::ActionRemoved) {
+            ++removed;
+        }
+        return false;
+    }
+    void reset()
+    {
+        added = removed = 0;
+    }
+    int added;
+    int removed;
+};
+
+void KXmlGui_UnitTest::testReplaceActionList()
+{
+    const QByteArray xml =
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui version=\"1\" name=\"foo\" >\n"
+        "<MenuBar>\n"
+        " <Menu name=\"file\"><text>File</text>\n"
+        "  <ActionList name=\"recent_list\"/>\n"
+        "  <Separator />"
+        "  <Action name=\"file_quit\" />\n"
+        "  <ActionList name=\"second_list\"/>\n"
+        " </Menu>\n"
+        "</MenuBar>\n"
+        "</gui>";
+
+    TestGuiClient client(xml);
+    client.createActions(QStringList() << QStringLiteral("file_quit"));
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+    factory.addClient(&client);
+
+    QMenu *menu = qobject_cast<QMenu *>(factory.container(QStringLiteral("file"), &client));
+    QVERIFY(menu);
+    ActionEventCounter counter(menu);
+
+    QList<QAction *> recent;
+    for (int i = 0; i < 4; ++i) {
+        QAction *action = new QAction(this);
+        action->setObjectName(QStringLiteral("recent%1").arg(i));
+        recent.append(action);
+    }
+    client.actionCollection()->setDefaultShortcut(recent.at(0), QKeySequence(QStringLiteral("Ctrl+2")));
+
+    // works like plugActionList the first time
+    client.replaceActionList(QStringLiteral("recent_list"), QList<QAction *>() << recent.at(1) << recent.at(2) << recent.at(3));
+    checkActions(menu->actions(), QStringList() << QStringLiteral("recent1") << QStringLiteral("recent2") << QStringLiteral("recent3")
+                 << QStringLiteral("separator") << QStringLiteral("file_quit"));
+    QCOMPARE(counter.added, 3);
+    QCOMPARE(counter.removed, 0);
+
+    QAction *second = new QAction(this);
+    second->setObjectName(QStringLiteral("second"));
+    client.plugActionList(QStringLiteral("second_list"), QList<QAction *>() << second);
+
+    // a file was opened: only the first and last actions change
+    counter.reset();
+    client.replaceActionList(QStringLiteral("recent_list"), QList<QAction *>() << recent.at(0) << recent.at(1) << recent.at(2));
+    checkActions(menu->actions(), QStringList() << QStringLiteral("recent0") << QStringLiteral("recent1") << QStringLiteral("recent2")
+                 << QStringLiteral("separator") << QStringLiteral("file_quit") << QStringLiteral("second"));
+    QCOMPARE(counter.added, 1);
+    QCOMPARE(counter.removed, 1);
+    QCOMPARE(QKeySequence::listToString(recent.at(0)->shortcuts()), QStringLiteral("Ctrl+2"));
+
+    // moving an action
+    counter.reset();
+    client.replaceActionList(QStringLiteral("recent_list"), QList<QAction *>() << recent.at(2) << recent.at(0) << recent.at(1));
+    checkActions(menu->actions(), QStringList() << QStringLiteral("recent2") << QStringLiteral("recent0") << QStringLiteral("recent1")
+                 << QStringLiteral("separator") << QStringLiteral("file_quit") << QStringLiteral("second"));
+    QCOMPARE(counter.added, 1);
+    QCOMPARE(counter.removed, 1);
+
+    // the merging indices are still right
+    client.replaceActionList(QStringLiteral("recent_list"), QList<QAction *>());
+    checkActions(menu->actions(), QStringList() << QStringLiteral("separator") << QStringLiteral("file_quit") << QStringLiteral("second"));
+    client.replaceActionList(QStringLiteral("second_list"), QList<QAction *>() << recent.at(3));
+    checkActions(menu->actions(), QStringList() << QStringLiteral("separator") << QStringLiteral("file_quit") << QStringLiteral("recent3"));
+    client.plugActionList(QStringLiteral("recent_list"), QList<QAction *>() << recent.at(0));
+    checkActions(menu->actions(), QStringList() << QStringLiteral("recent0") << QStringLiteral("separator") << QStringLiteral("file_quit")
+                 << QStringLiteral("recent3"));
+    client.unplugActionList(QStringLiteral("second_list"));
+    checkActions(menu->actions(), QStringList() << QStringLiteral("recent0") << QStringLiteral("separator") << QStringLiteral("file_quit"));
+
+    factory.removeClient(&client);
+}
+
+void KXmlGui_UnitTest::testLazyMenuPopulation()
+{
+    const QByteArray xml =
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui version=\"1\" name=\"foo\" >\n"
+        "<MenuBar>\n"
+        " <Menu name=\"file\"><text>&amp;File</text>\n"
+        "  <Action name=\"file_open\"/>\n"
+        "  <Menu name=\"recent\"><text>Recent</text>\n"
+        "   <ActionList name=\"recent_list\"/>\n"
+        "  </Menu>\n"
+        "  <Separator/>\n"
+        "  <Action name=\"file_quit\"/>\n"
+        " </Menu>\n"
+        " <Menu name=\"edit\"><text>&amp;Edit</text>\n"
+        "  <Action name=\"edit_copy\"/>\n"
+        " </Menu>\n"
+        "</MenuBar>\n"
+        "</gui>\n";
+
+    TestGuiClient client(xml);
+    client.createActions(QStringList() << QStringLiteral("file_open") << QStringLiteral("file_quit")
+                         << QStringLiteral("edit_copy"));
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+    QVERIFY(!factory.lazyMenuPopulation());
+    factory.setLazyMenuPopulation(true);
+    factory.addClient(&client);
+
+    // the menus exist, but are empty until shown
+    QCOMPARE(mainWindow.menuBar()->actions().count(), 2);
+    QMenu *fileMenu = qobject_cast<QMenu *>(factory.container(QStringLiteral("file"), &client));
+    QVERIFY(fileMenu);
+    QMenu *editMenu = qobject_cast<QMenu *>(factory.container(QStringLiteral("edit"), &client));
+    QVERIFY(editMenu);
+    QVERIFY(fileMenu->actions().isEmpty());
+    QVERIFY(editMenu->actions().isEmpty());
+
+    QMetaObject::invokeMethod(fileMenu, "aboutToShow");
+    checkActions(fileMenu->actions(), QStringList() << QStringLiteral("file_open") << QStringLiteral("recent")
+                 << QStringLiteral("separator") << QStringLiteral("file_quit"));
+    QMetaObject::invokeMethod(fileMenu, "aboutToShow"); // only populated once
+    QCOMPARE(fileMenu->actions().count(), 4);
+    QVERIFY(editMenu->actions().isEmpty());
+
+    // plugging an action list populates the menu containing it
+    QMenu *recentMenu = qobject_cast<QMenu *>(factory.container(QStringLiteral("recent"), &client));
+    QVERIFY(recentMenu);
+    QVERIFY(recentMenu->actions().isEmpty());
+    QAction *recent1 = new QAction(this);
+    recent1->setObjectName(QStringLiteral("recent1"));
+    client.plugActionList(QStringLiteral("recent_list"), QList<QAction *>() << recent1);
+    checkActions(recentMenu->actions(), QStringList() << QStringLiteral("recent1"));
+
+    // removing the client removes the menus which weren't populated as well
+    QPointer<QMenu> fileMenuGuard(fileMenu);
+    QPointer<QMenu> editMenuGuard(editMenu);
+    factory.removeClient(&client);
+    QVERIFY(!fileMenuGuard);
+    QVERIFY(!editMenuGuard);
+    QVERIFY(!factory.container(QStringLiteral("edit"), nullptr));
+
+    // disabling lazy population populates everything
+    factory.addClient(&client);
+    editMenu = qobject_cast<QMenu *>(factory.container(QStringLiteral("edit"), &client));
+    QVERIFY(editMenu);
+    QVERIFY(editMenu->actions().isEmpty());
+    factory.setLazyMenuPopulation(false);
+    checkActions(editMenu->actions(), QStringList() << QStringLiteral("edit_copy"));
+    QVERIFY(factory.container(QStringLiteral("recent"), &client));
+
+    factory.removeClient(&client);
+    delete recent1;
+}
+
+void KXmlGui_UnitTest::testLazyMenuActionList()
+{
+    const QByteArray xml =
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui version=\"1\" name=\"foo\" >\n"
+        "<MenuBar>\n"
+        " <Menu name=\"file\"><text>&amp;File</text>\n"
+        "  <Action name=\"file_open\"/>\n"
+        "  <Menu name=\"recent\"><text>Recent</text>\n"
+        "   <ActionList name=\"recent_list\"/>\n"
+        "  </Menu>\n"
+        " </Menu>\n"
+        " <Menu name=\"edit\"><text>&amp;Edit</text>\n"
+        "  <Action name=\"edit_copy\"/>\n"
+        " </Menu>\n"
+        "</MenuBar>\n"
+        "</gui>\n";
+
+    TestGuiClient client(xml);
+    client.createActions(QStringList() << QStringLiteral("file_open") << QStringLiteral("edit_copy"));
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+    factory.setLazyMenuPopulation(true);
+    factory.addClient(&client);
+    QMenu *fileMenu = qobject_cast<QMenu *>(factory.container(QStringLiteral("file"), &client));
+    QVERIFY(fileMenu);
+    QMenu *editMenu = qobject_cast<QMenu *>(factory.container(QStringLiteral("edit"), &client));
+    QVERIFY(editMenu);
+    QVERIFY(fileMenu->actions().isEmpty());
+
+    // plugging the list populates the menus leading to it, and only those
+    QAction *recent1 = new QAction(this);
+    recent1->setObjectName(QStringLiteral("recent1"));
+    client.plugActionList(QStringLiteral("recent_list"), QList<QAction *>() << recent1);
+    checkActions(fileMenu->actions(), QStringList() << QStringLiteral("file_open") << QStringLiteral("recent"));
+    QMenu *recentMenu = qobject_cast<QMenu *>(factory.container(QStringLiteral("recent"), &client));
+    QVERIFY(recentMenu);
+    checkActions(recentMenu->actions(), QStringList() << QStringLiteral("recent1"));
+    QVERIFY(editMenu->actions().isEmpty());
+
+    // same for replacing it, and for lists which don't exist
+    QAction *recent2 = new QAction(this);
+    recent2->setObjectName(QStringLiteral("recent2"));
+    client.replaceActionList(QStringLiteral("recent_list"), QList<QAction *>() << recent2 << recent1);
+    checkActions(recentMenu->actions(), QStringList() << QStringLiteral("recent2") << QStringLiteral("recent1"));
+    client.plugActionList(QStringLiteral("no_such_list"), QList<QAction *>() << recent2);
+    QVERIFY(editMenu->actions().isEmpty());
+
+    QMetaObject::invokeMethod(editMenu, "aboutToShow");
+    checkActions(editMenu->actions(), QStringList() << QStringLiteral("edit_copy"));
+
+    factory.removeClient(&client);
+    delete recent1;
+    delete recent2;
+}
+
 void KXmlGui_UnitTest::testHiddenToolBar()
 {
     const QByteArray xml =
@@ -928,6 +1571,38 @@ void KXmlGui_UnitTest::testMenusNoXmlFile()
                  << QStringLiteral("help"));
 }
 
+void KXmlGui_UnitTest::testPreloadXMLFile()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    createXmlFile(file, 2, AddToolBars);
+    const QString fileName = file.fileName();
+    file.close();
+
+    TestGuiClient expected;
+    expected.setXMLFilePublic(fileName);
+
+    KXMLGUIClient::preloadXMLFile(fileName);
+    TestGuiClient client;
+    client.setXMLFilePublic(fileName);
+    QCOMPARE(client.domDocument().toString(), expected.domDocument().toString());
+    QVERIFY(!client.domDocument().toString().contains(QStringLiteral("<Action name=\"home\"")));
+
+    // a preloaded document is only used once
+    QVERIFY(file.open());
+    QVERIFY(file.resize(0));
+    createXmlFile(file, 2, AddModifiedToolBars);
+    file.close();
+    client.setXMLFilePublic(fileName);
+    QVERIFY(client.domDocument().toString().contains(QStringLiteral("<Action name=\"home\"")));
+
+    // a file which doesn't exist
+    KXMLGUIClient::preloadXMLFile(QStringLiteral("/does/not/exist.rc"));
+    TestGuiClient noFileClient;
+    noFileClient.setXMLFilePublic(QStringLiteral("/does/not/exist.rc"));
+    QVERIFY(noFileClient.domDocument().documentElement().isNull());
+}
+
 void KXmlGui_UnitTest::testXMLFileReplacement()
 {
     // to differentiate "original" and replacement xml file, one is created with "modified" toolbars
@@ -984,6 +1659,189 @@ void KXmlGui_UnitTest::testXMLFileReplacement()
     QVERIFY(!xml.contains(QStringLiteral("<ActionProperties>"))); // but no local xml file
 }
 
+void KXmlGui_UnitTest::testDocumentSharing()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    createXmlFile(file, 2, AddToolBars);
+    file.close();
+
+    KXMLGUIClient::setDocumentSharingEnabled(true);
+    QVERIFY(KXMLGUIClient::isDocumentSharingEnabled());
+    {
+        TestGuiClient client1;
+        client1.setXMLFilePublic(file.fileName());
+        TestGuiClient client2;
+        client2.setXMLFilePublic(file.fileName());
+        QVERIFY(!client1.domDocument().isNull());
+        QVERIFY(client1.domDocument() == client2.domDocument());
+        QVERIFY(client1.estimatedDomMemoryUsage() > 0);
+        QCOMPARE(client1.estimatedDomMemoryUsage(), client2.estimatedDomMemoryUsage());
+
+        // merging works on a copy
+        const QString sharedXml = client1.domDocument().toString();
+        client2.createGUI("<gui version=\"3\" name=\"foo\"><MenuBar><Menu name=\"extra\"><Action name=\"extra_action\"/></Menu></MenuBar></gui>");
+        QVERIFY(client1.domDocument() != client2.domDocument());
+        QCOMPARE(client1.domDocument().toString(), sharedXml);
+        QVERIFY(client2.domDocument().toString() != sharedXml);
+
+        // a new client still gets the shared document
+        TestGuiClient client3;
+        client3.setXMLFilePublic(file.fileName());
+        QVERIFY(client3.domDocument() == client1.domDocument());
+    }
+    KXMLGUIClient::setDocumentSharingEnabled(false);
+
+    TestGuiClient client1;
+    client1.setXMLFilePublic(file.fileName());
+    TestGuiClient client2;
+    client2.setXMLFilePublic(file.fileName());
+    QVERIFY(client1.domDocument() != client2.domDocument());
+    QCOMPARE(client1.domDocument().toString(), client2.domDocument().toString());
+}
+
+void KXmlGui_UnitTest::testFileIndex()
+{
+    const QString dataDir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+    const QString dir = dataDir + QStringLiteral("/kxmlgui5/fileindextest");
+    const QString compatDir = dataDir + QStringLiteral("/fileindextest");
+    QDir(dir).removeRecursively();
+    QDir(compatDir).removeRecursively();
+
+    const QString file = QStringLiteral("kxmlgui5/fileindextest/test.rc");
+    const QString compatFile = QStringLiteral("fileindextest/compat.rc");
+
+    KXmlGuiFileIndex index;
+    QVERIFY(index.locate(file).isEmpty());
+    QVERIFY(index.locateAll(file).isEmpty());
+    QVERIFY(index.locate(compatFile).isEmpty());
+
+    QVERIFY(QDir().mkpath(dir));
+    QVERIFY(QDir().mkpath(compatDir));
+    QFile rcFile(dataDir + QLatin1Char('/') + file);
+    QVERIFY(rcFile.open(QIODevice::WriteOnly));
+    rcFile.close();
+    QFile compatRcFile(dataDir + QLatin1Char('/') + compatFile);
+    QVERIFY(compatRcFile.open(QIODevice::WriteOnly));
+    compatRcFile.close();
+
+    // compatibility locations aren't indexed
+    QCOMPARE(index.locate(compatFile), compatRcFile.fileName());
+
+    // the index is trusted for a while, then the directory is checked again
+    QVERIFY(index.locate(file).isEmpty());
+    QTRY_COMPARE(index.locate(file), rcFile.fileName());
+
+    index.invalidate();
+    QCOMPARE(index.locate(file), QStandardPaths::locate(QStandardPaths::GenericDataLocation, file));
+    QCOMPARE(index.locateAll(file), QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, file));
+    QCOMPARE(index.locate(file), rcFile.fileName());
+    QVERIFY(index.locate(QStringLiteral("kxmlgui5/fileindextest/other.rc")).isEmpty());
+    QVERIFY(index.locate(QStringLiteral("kxmlgui5/fileindextest")).isEmpty()); // not a file
+
+    QVERIFY(QDir(dir).removeRecursively());
+    QVERIFY(QDir(compatDir).removeRecursively());
+    QVERIFY(index.locate(compatFile).isEmpty());
+    QTRY_VERIFY(index.locate(file).isEmpty());
+}
+
+void KXmlGui_UnitTest::testProfiler()
+{
+    QTemporaryFile file(QDir::tempPath() + QStringLiteral("/profiledXXXXXX.rc"));
+    QVERIFY(file.open());
+    createXmlFile(file, 2, AddToolBars | AddActionProperties);
+    file.close();
+
+    // the library's own profiler records what adding a client does
+    KXmlGuiProfiler::setEnabled(true);
+    TestGuiClient client;
+    client.setXMLFilePublic(file.fileName(), false, true);
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+    factory.addClient(&client);
+    {
+        KXmlGuiProfiler::Phase outer("outerPhase", &client);
+        KXmlGuiProfiler::Phase inner("innerPhase"); // counts for the client of the outer phase
+    }
+    factory.removeClient(&client);
+    KXmlGuiProfiler::setEnabled(false);
+    {
+        KXmlGuiProfiler::Phase ignored("ignoredPhase", &client);
+    }
+
+    const QString clientName = client.componentName() + QLatin1Char('/') + QFileInfo(file.fileName()).fileName();
+    const QJsonObject trace = QJsonDocument::fromJson(KXmlGuiProfiler::traceJson()).object();
+    QStringList names;
+    Q_FOREACH (const QJsonValue &value, trace.value(QStringLiteral("traceEvents")).toArray()) {
+        const QJsonObject event = value.toObject();
+        QCOMPARE(event.value(QStringLiteral("ph")).toString(), QStringLiteral("X"));
+        QVERIFY(event.value(QStringLiteral("dur")).toDouble() >= 0);
+        if (event.value(QStringLiteral("args")).toObject().value(QStringLiteral("client")).toString() == clientName) {
+            names.append(event.value(QStringLiteral("name")).toString());
+        }
+    }
+    // the phases of setXMLFile and addClient, including the nested ones without a client of their own
+    Q_FOREACH (const QString &phase, QStringList() << QStringLiteral("setXMLFile") << QStringLiteral("parseXML")
+               << QStringLiteral("addClient") << QStringLiteral("refreshActionProperties") << QStringLiteral("build")
+               << QStringLiteral("createContainer")) {
+        QVERIFY2(names.contains(phase), qPrintable(phase));
+    }
+    // inner phases end first
+    QVERIFY(names.indexOf(QStringLiteral("setXMLFile")) > names.indexOf(QStringLiteral("parseXML")));
+    QVERIFY(names.indexOf(QStringLiteral("addClient")) > names.indexOf(QStringLiteral("build")));
+    QCOMPARE(names.mid(names.indexOf(QStringLiteral("innerPhase"))),
+             QStringList() << QStringLiteral("innerPhase") << QStringLiteral("outerPhase"));
+    QVERIFY(!names.contains(QStringLiteral("ignoredPhase")));
+}
+
+void KXmlGui_UnitTest::testXmlGuiCache()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    createXmlFile(file, 2, AddToolBars | AddActionProperties);
+    const QString fileName = file.fileName();
+    file.close();
+
+    QDomDocument doc;
+    QVERIFY(doc.setContent(KXMLGUIFactory::readConfigFile(fileName)));
+
+    // serialization round-trip
+    QDomDocument copy;
+    QVERIFY(KXmlGuiCache::deserialize(KXmlGuiCache::serialize(doc), copy));
+    const QDomElement docElem = copy.documentElement();
+    QCOMPARE(docElem.tagName(), QStringLiteral("gui"));
+    QCOMPARE(docElem.attribute(QStringLiteral("version")), QStringLiteral("2"));
+    QCOMPARE(copy.elementsByTagName(QStringLiteral("Action")).count(), doc.elementsByTagName(QStringLiteral("Action")).count());
+    QCOMPARE(copy.elementsByTagName(QStringLiteral("text")).item(0).toElement().text(),
+             doc.elementsByTagName(QStringLiteral("text")).item(0).toElement().text());
+    QCOMPARE(copy.toString().length(), doc.toString().length());
+    QVERIFY(!KXmlGuiCache::deserialize(QByteArray("garbage"), copy));
+
+    // save, load, and invalidation by modifying a source file
+    const QString component = QStringLiteral("kxmlgui_unittest_cache");
+    KXmlGuiCache::invalidate(component);
+    KXmlGuiCache cache(component, QStringList() << fileName);
+    QDomDocument loaded;
+    QVERIFY(!cache.load(loaded));
+    cache.save(doc, QStringList() << fileName);
+    QVERIFY(QFile::exists(cache.cacheFileName()));
+    QVERIFY(cache.load(loaded));
+    QCOMPARE(loaded.documentElement().attribute(QStringLiteral("name")), QStringLiteral("foo"));
+
+    KXmlGuiCache otherCache(component, QStringList() << fileName << QStringLiteral("other"));
+    QVERIFY(!otherCache.load(loaded));
+
+    QVERIFY(file.open());
+    file.seek(file.size());
+    file.write("<!-- modified -->\n");
+    file.close();
+    QVERIFY(!cache.load(loaded));
+
+    KXmlGuiCache::invalidate(component);
+    QVERIFY(!QFile::exists(cache.cacheFileName()));
+}
+
 void KXmlGui_UnitTest::testClientDestruction()   // #170806
 {
     const QByteArray hostXml =
@@ -1061,6 +1919,168 @@ void KXmlGui_UnitTest::testShortcuts()
     factory.removeClient(&client);
 }
 
+void KXmlGui_UnitTest::testReapplyActionProperties()
+{
+    const QByteArray xml = "<?xml version = '1.0'?>\n"
+                           "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+                           "<gui version=\"1\" name=\"foo\" >\n"
+                           "<MenuBar>\n"
+                           " <Menu name=\"file\"><text>&amp;File</text>\n"
+                           "  <Action name=\"file_open\"/>\n"
+                           "  <Action name=\"file_quit\"/>\n"
+                           " </Menu>\n"
+                           "</MenuBar>\n"
+                           "<ActionProperties scheme=\"Default\">\n"
+                           "  <Action shortcut=\"Ctrl+O\" name=\"file_open\" iconText=\"Open it\"/>\n"
+                           "  <Action shortcut=\"Ctrl+Q; Ctrl+D\" name=\"file_quit\"/>\n"
+                           "</ActionProperties>\n"
+                           "</gui>";
+
+    TestGuiClient client;
+    client.createActions(QStringList() << QStringLiteral("file_open") << QStringLiteral("file_quit"));
+    client.createGUI(xml, false /*ui_standards.rc*/);
+
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+    factory.addClient(&client);
+
+    QAction *actionOpen = client.action("file_open");
+    QVERIFY(actionOpen);
+    QCOMPARE(actionOpen->shortcuts(), QList<QKeySequence>() << QKeySequence(QStringLiteral("Ctrl+O")));
+    QCOMPARE(actionOpen->iconText(), QStringLiteral("Open it"));
+
+    // plugging an action list applies the action properties again
+    actionOpen->setShortcut(QKeySequence(QStringLiteral("Ctrl+K")));
+    client.plugActionList(QStringLiteral("none"), QList<QAction *>());
+    QCOMPARE(actionOpen->shortcuts(), QList<QKeySequence>() << QKeySequence(QStringLiteral("Ctrl+O")));
+
+    // ... from the current document
+    QByteArray changedXml = xml;
+    changedXml.replace("<Action shortcut=\"Ctrl+O\"", "<Action shortcut=\"Ctrl+P\"");
+    client.createGUI(changedXml, false /*ui_standards.rc*/);
+    client.plugActionList(QStringLiteral("none"), QList<QAction *>());
+    QCOMPARE(actionOpen->shortcuts(), QList<QKeySequence>() << QKeySequence(QStringLiteral("Ctrl+P")));
+
+    factory.removeClient(&client);
+}
+
+static void writeShortcutScheme(const QString &schemeName, const QByteArray &actions)
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) +
+                        QLatin1Char('/') + QCoreApplication::applicationName() + QStringLiteral("/shortcuts");
+    QVERIFY(QDir().mkpath(dir));
+    QFile file(dir + QLatin1Char('/') + schemeName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("<gui version=\"1\" name=\"foo\" >\n"
+               "<ActionProperties scheme=\"" + schemeName.toUtf8() + "\">\n" +
+               actions +
+               "</ActionProperties>\n"
+               "</gui>");
+}
+
+void KXmlGui_UnitTest::testShortcutScheme()
+{
+    const QByteArray xml = "<?xml version = '1.0'?>\n"
+                           "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+                           "<gui version=\"1\" name=\"foo\" >\n"
+                           "<MenuBar>\n"
+                           " <Menu name=\"file\"><text>&amp;File</text>\n"
+                           "  <Action name=\"file_open\"/>\n"
+                           "  <Action name=\"file_quit\"/>\n"
+                           "  <Action name=\"file_close\"/>\n"
+                           " </Menu>\n"
+                           "</MenuBar>\n"
+                           "</gui>";
+
+    // both files exist before the first lookup, and keep their names
+    writeShortcutScheme(QStringLiteral("Foo"),
+                        "  <Action name=\"file_open\" shortcut=\"Ctrl+O\"/>\n"
+                        "  <Action name=\"file_quit\" shortcut=\"Ctrl+Q; Ctrl+D\" iconText=\"Leave\"/>\n");
+    writeShortcutScheme(QStringLiteral("Bar"),
+                        "  <Action name=\"file_open\" shortcut=\"Ctrl+O\"/>\n"
+                        "  <Action name=\"file_close\" shortcut=\"Ctrl+W\"/>\n");
+
+    KConfigGroup group = KSharedConfig::openConfig()->group("Shortcut Schemes");
+    group.writeEntry("Current Scheme", "Foo");
+
+    TestGuiClient client;
+    client.createActions(QStringList() << QStringLiteral("file_open") << QStringLiteral("file_quit") << QStringLiteral("file_close"));
+    QAction *actionOpen = client.action("file_open");
+    QAction *actionQuit = client.action("file_quit");
+    QAction *actionClose = client.action("file_close");
+    actionClose->setShortcut(QKeySequence(QStringLiteral("Ctrl+K")));
+    client.createGUI(xml, false /*ui_standards.rc*/);
+
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+    factory.addClient(&client);
+
+    const QList<QKeySequence> ctrlO = QList<QKeySequence>() << QKeySequence(QStringLiteral("Ctrl+O"));
+    QCOMPARE(actionOpen->shortcuts(), ctrlO);
+    QCOMPARE(actionOpen->property("defaultShortcuts").value<QList<QKeySequence> >(), ctrlO);
+    QCOMPARE(actionQuit->shortcuts(), QList<QKeySequence>() << QKeySequence(QStringLiteral("Ctrl+Q")) << QKeySequence(QStringLiteral("Ctrl+D")));
+    QCOMPARE(actionQuit->iconText(), QStringLiteral("Leave"));
+    // not in the scheme
+    QVERIFY(actionClose->shortcuts().isEmpty());
+
+    // applying another scheme only touches the actions whose shortcuts change
+    group.writeEntry("Current Scheme", "Bar");
+    QSignalSpy openChanged(actionOpen, &QAction::changed);
+    QSignalSpy quitChanged(actionQuit, &QAction::changed);
+    client.plugActionList(QStringLiteral("none"), QList<QAction *>());
+    QCOMPARE(actionOpen->shortcuts(), ctrlO);
+    QCOMPARE(openChanged.count(), 0);
+    QVERIFY(actionQuit->shortcuts().isEmpty());
+    QVERIFY(quitChanged.count() > 0);
+    QCOMPARE(actionClose->shortcuts(), QList<QKeySequence>() << QKeySequence(QStringLiteral("Ctrl+W")));
+
+    factory.removeClient(&client);
+    group.writeEntry("Current Scheme", "Default");
+    QFile::remove(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1Char('/') +
+                  QCoreApplication::applicationName() + QStringLiteral("/shortcuts/Foo"));
+    QFile::remove(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1Char('/') +
+                  QCoreApplication::applicationName() + QStringLiteral("/shortcuts/Bar"));
+}
+
+void KXmlGui_UnitTest::testShortcutSchemeRenamedAction()
+{
+    const QByteArray xml = "<?xml version = '1.0'?>\n"
+                           "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+                           "<gui version=\"1\" name=\"foo\" >\n"
+                           "<MenuBar>\n"
+                           " <Menu name=\"file\"><text>&amp;File</text>\n"
+                           "  <Action name=\"file_quit\"/>\n"
+                           " </Menu>\n"
+                           "</MenuBar>\n"
+                           "</gui>";
+
+    writeShortcutScheme(QStringLiteral("Renamed"),
+                        "  <Action name=\"file_quit\" shortcut=\"Ctrl+Q\"/>\n");
+    KConfigGroup group = KSharedConfig::openConfig()->group("Shortcut Schemes");
+    group.writeEntry("Current Scheme", "Renamed");
+
+    TestGuiClient client;
+    client.createActions(QStringList() << QStringLiteral("file_quit"));
+    QAction *actionQuit = client.action("file_quit");
+    // the scheme refers to actions by the name they were added to the collection with
+    actionQuit->setObjectName(QStringLiteral("quit_renamed"));
+    client.createGUI(xml, false /*ui_standards.rc*/);
+
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+    factory.addClient(&client);
+
+    QCOMPARE(actionQuit->shortcuts(), QList<QKeySequence>() << QKeySequence(QStringLiteral("Ctrl+Q")));
+
+    factory.removeClient(&client);
+    group.writeEntry("Current Scheme", "Default");
+    QFile::remove(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1Char('/') +
+                  QCoreApplication::applicationName() + QStringLiteral("/shortcuts/Renamed"));
+}
+
 void KXmlGui_UnitTest::testPopupMenuParent()
 {
     const QByteArray xml =
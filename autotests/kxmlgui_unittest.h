@@ -30,23 +30,39 @@ private Q_SLOTS:
     void initTestCase();
     void testFindVersionNumber_data();
     void testFindVersionNumber();
+    void testFindVersionNumberInFile();
     void testVersionHandlerSameVersion();
     void testVersionHandlerNewVersionNothingKept();
     void testVersionHandlerNewVersionUserChanges();
     void testPartMerging();
     void testPartMergingSettings();
+    void testReplaceClient();
+    void testContainerLookup();
+    void testBatch();
+    void testMergeXML();
     void testUiStandardsMerging_data();
     void testUiStandardsMerging();
     void testActionListAndSeparator();
+    void testReplaceActionList();
+    void testLazyMenuPopulation();
+    void testLazyMenuActionList();
     void testHiddenToolBar();
     void testDeletedContainers();
     void testAutoSaveSettings();
+    void testPreloadXMLFile();
     void testXMLFileReplacement();
+    void testXmlGuiCache();
+    void testFileIndex();
+    void testProfiler();
+    void testDocumentSharing();
     void testTopLevelSeparator();
     void testMenuNames();
     void testClientDestruction();
     void testMenusNoXmlFile();
     void testShortcuts();
+    void testReapplyActionProperties();
+    void testShortcutScheme();
+    void testShortcutSchemeRenamedAction();
     void testPopupMenuParent();
     void testSpecificApplicationLanguageQLocale();
 };
@@ -0,0 +1,497 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <QTest>
+#include <QDomDocument>
+#include <QElapsedTimer>
+#include <QMenu>
+#include <QShowEvent>
+#include <QTemporaryFile>
+
+#include <kactioncollection.h>
+#include <kedittoolbar.h>
+#include <kmainwindow.h>
+#include <kxmlguibuilder.h>
+#include <kxmlguifactory.h>
+
+#include "testguiclient.h"
+
+#include <kxmlguiloader.cpp> // it's not exported, so we need to include the code here
+
+#include "rcfilegenerator.h"
+
+// A single menu with @p actionCount actions (and a merge point and action list), like
+// a bookmark or plugin menu.
+static QByteArray generateMenuRcFile(int actionCount)
+{
+    QByteArray xml =
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui name=\"benchmark\" version=\"1\">\n"
+        "<MenuBar>\n"
+        " <Menu name=\"big\"><text>Big</text>\n";
+    for (int i = 0; i < actionCount; ++i) {
+        if (i == actionCount / 2) {
+            xml += "  <Merge/>\n"
+                   "  <ActionList name=\"list\"/>\n";
+        }
+        xml += "  <Action name=\"action" + QByteArray::number(i) + "\"/>\n";
+    }
+    xml += " </Menu>\n"
+           "</MenuBar>\n"
+           "</gui>\n";
+    return xml;
+}
+
+static QStringList actionNames(int actionCount)
+{
+    QStringList names;
+    names.reserve(actionCount);
+    for (int i = 0; i < actionCount; ++i) {
+        names << QStringLiteral("action%1").arg(i);
+    }
+    return names;
+}
+
+// The actions of generateRcFile(@p actionCount), including those of the submenus
+static QStringList rcFileActionNames(int actionCount)
+{
+    QStringList names = actionNames(actionCount);
+    for (int action = 10; action < actionCount; action += 20) {
+        names << QStringLiteral("subaction%1").arg(action);
+    }
+    return names;
+}
+
+// A part's xmlgui file, merged into the menus and the first toolbar of
+// generateRcFile(@p actionCount), e.g. by KParts or plugins.
+static QByteArray generatePartRcFile(int actionCount)
+{
+    QByteArray xml =
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui name=\"benchmarkpart\" version=\"1\">\n"
+        "<MenuBar>\n";
+    for (int menu = 0; menu * 20 < actionCount; ++menu) {
+        xml += " <Menu name=\"menu" + QByteArray::number(menu) + "\">\n"
+               "  <Action name=\"partaction" + QByteArray::number(menu) + "\"/>\n"
+               " </Menu>\n";
+    }
+    xml += "</MenuBar>\n"
+           "<ToolBar name=\"toolBar0\">\n"
+           " <Action name=\"partaction0\"/>\n"
+           "</ToolBar>\n"
+           "</gui>\n";
+    return xml;
+}
+
+// The sizes of the generated xmlgui files, from a small plugin to the largest applications
+static void addRcFileSizeRows()
+{
+    QTest::addColumn<int>("actionCount");
+
+    Q_FOREACH (int actionCount, QList<int>() << 10 << 100 << 1000 << 10000) {
+        QTest::newRow(qPrintable(QStringLiteral("%1 actions").arg(actionCount))) << actionCount;
+    }
+}
+
+// QBENCHMARK measures the whole loop body, this leaves out undoing @p step
+// (and other setup) between the runs.
+template<typename Step, typename Undo>
+static void benchmarkStep(int actionCount, Step step, Undo undo)
+{
+    const int iterations = qMax(3, 10000 / actionCount);
+    QElapsedTimer timer;
+    qint64 total = 0;
+    for (int i = 0; i < iterations; ++i) {
+        timer.start();
+        step();
+        total += timer.nsecsElapsed();
+        undo();
+    }
+    QTest::setBenchmarkResult(total / 1000000.0 / iterations, QTest::WalltimeMilliseconds);
+}
+
+class tst_KXmlGuiBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testLoaderMatchesDom_data();
+    void testLoaderMatchesDom();
+    void testLoaderError();
+    void benchmarkLoad_data();
+    void benchmarkLoad();
+    void benchmarkBuildMenu_data();
+    void benchmarkBuildMenu();
+    void benchmarkPlugActionList_data();
+    void benchmarkPlugActionList();
+    void benchmarkReplaceActionList_data();
+    void benchmarkReplaceActionList();
+    void benchmarkSetXML_data();
+    void benchmarkSetXML();
+    void benchmarkMergeXML_data();
+    void benchmarkMergeXML();
+    void benchmarkAddClient_data();
+    void benchmarkAddClient();
+    void benchmarkRemoveClient_data();
+    void benchmarkRemoveClient();
+    void benchmarkEditToolBarLoad_data();
+    void benchmarkEditToolBarLoad();
+};
+
+QTEST_MAIN(tst_KXmlGuiBenchmark)
+
+void tst_KXmlGuiBenchmark::testLoaderMatchesDom_data()
+{
+    QTest::addColumn<QByteArray>("xml");
+
+    QTest::newRow("generated") << generateRcFile(100);
+    QTest::newRow("own domain") <<
+        QByteArray("<!DOCTYPE gui>\n"
+                   "<gui name=\"foo\" version=\"1\" translationDomain=\"foo\">\n"
+                   "<MenuBar><Menu name=\"file\"><text>&amp;File</text><Action name=\"open\"/></Menu></MenuBar>\n"
+                   "<Menu name=\"popup\"><title>Popup</title></Menu>\n"
+                   "</gui>");
+    QTest::newRow("comments, cdata, pi") <<
+        QByteArray("<?xml version=\"1.0\"?>\n"
+                   "<!-- leading comment -->\n"
+                   "<gui name=\"foo\" version=\"1\">\n"
+                   "<?kxmlgui something?>\n"
+                   "<MenuBar>\n  <!-- a comment -->\n  <Menu name=\"edit\"><text>A  <![CDATA[<b>]]> b</text></Menu>\n</MenuBar>\n"
+                   "<State name=\"s\"><enable><Action name=\"a\"/></enable></State>\n"
+                   "</gui>");
+    QTest::newRow("namespaces") <<
+        QByteArray("<gui name=\"foo\" version=\"2\" xmlns=\"http://www.kde.org/standards/kxmlgui/1.0\"\n"
+                   "     xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"\n"
+                   "     xsi:schemaLocation=\"http://www.kde.org/standards/kxmlgui/1.0 http://www.kde.org/standards/kxmlgui/1.0/kxmlgui.xsd\">\n"
+                   "<ToolBar name=\"mainToolBar\"><text>Main Toolbar</text></ToolBar>\n"
+                   "</gui>");
+}
+
+void tst_KXmlGuiBenchmark::testLoaderMatchesDom()
+{
+    QFETCH(QByteArray, xml);
+
+    const QDomDocument expected = loadWithDom(xml);
+    QVERIFY(!expected.documentElement().isNull());
+    const QDomDocument doc = loadWithStreamReader(xml);
+    QCOMPARE(doc.toString(), expected.toString());
+
+    // The QString code path (KXMLGUIClient::setXML) gives the same result
+    QDomDocument docFromString;
+    QVERIFY(KXmlGuiLoader::load(QString::fromUtf8(xml), docFromString, s_domain, textTagNames()));
+    QCOMPARE(docFromString.toString(), expected.toString());
+}
+
+void tst_KXmlGuiBenchmark::testLoaderError()
+{
+    QDomDocument doc;
+    KXmlGuiLoader::Error error;
+    QVERIFY(!KXmlGuiLoader::load(QByteArray("<gui>\n<MenuBar>\n</gui>"), doc, s_domain, textTagNames(), &error));
+    QVERIFY(doc.isNull());
+    QVERIFY(!error.message.isEmpty());
+    QCOMPARE(error.line, 3);
+}
+
+void tst_KXmlGuiBenchmark::benchmarkLoad_data()
+{
+    QTest::addColumn<QByteArray>("xml");
+    QTest::addColumn<bool>("streaming");
+
+    Q_FOREACH (int actionCount, QList<int>() << 100 << 1000 << 10000) {
+        const QByteArray xml = generateRcFile(actionCount);
+        QTest::newRow(qPrintable(QStringLiteral("setContent, %1 actions").arg(actionCount))) << xml << false;
+        QTest::newRow(qPrintable(QStringLiteral("stream reader, %1 actions").arg(actionCount))) << xml << true;
+    }
+}
+
+void tst_KXmlGuiBenchmark::benchmarkLoad()
+{
+    QFETCH(QByteArray, xml);
+    QFETCH(bool, streaming);
+
+    if (streaming) {
+        QBENCHMARK {
+            loadWithStreamReader(xml);
+        }
+    } else {
+        QBENCHMARK {
+            loadWithDom(xml);
+        }
+    }
+}
+
+static void addActionCountRows()
+{
+    QTest::addColumn<int>("actionCount");
+
+    // the time per action should stay about the same
+    Q_FOREACH (int actionCount, QList<int>() << 100 << 500 << 1000 << 5000) {
+        QTest::newRow(qPrintable(QStringLiteral("%1 actions").arg(actionCount))) << actionCount;
+    }
+}
+
+void tst_KXmlGuiBenchmark::benchmarkBuildMenu_data()
+{
+    addActionCountRows();
+}
+
+void tst_KXmlGuiBenchmark::benchmarkBuildMenu()
+{
+    QFETCH(int, actionCount);
+
+    TestGuiClient client(generateMenuRcFile(actionCount));
+    client.createActions(actionNames(actionCount));
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+
+    QBENCHMARK {
+        factory.addClient(&client);
+        factory.removeClient(&client);
+    }
+
+    factory.addClient(&client);
+    QMenu *menu = qobject_cast<QMenu *>(factory.container(QStringLiteral("big"), &client));
+    QVERIFY(menu);
+    QCOMPARE(menu->actions().count(), actionCount);
+    QCOMPARE(menu->actions().first()->objectName(), QStringLiteral("action0"));
+    QCOMPARE(menu->actions().last()->objectName(), QStringLiteral("action%1").arg(actionCount - 1));
+}
+
+void tst_KXmlGuiBenchmark::benchmarkPlugActionList_data()
+{
+    addActionCountRows();
+}
+
+void tst_KXmlGuiBenchmark::benchmarkPlugActionList()
+{
+    QFETCH(int, actionCount);
+
+    TestGuiClient client(generateMenuRcFile(actionCount));
+    client.createActions(actionNames(actionCount));
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+    factory.addClient(&client);
+
+    QList<QAction *> actionList;
+    for (int i = 0; i < actionCount; ++i) {
+        QAction *action = new QAction(QStringLiteral("List action"), &mainWindow);
+        action->setObjectName(QStringLiteral("listAction%1").arg(i));
+        actionList.append(action);
+    }
+
+    QBENCHMARK {
+        client.plugActionList(QStringLiteral("list"), actionList);
+        client.unplugActionList(QStringLiteral("list"));
+    }
+
+    client.plugActionList(QStringLiteral("list"), actionList);
+    QMenu *menu = qobject_cast<QMenu *>(factory.container(QStringLiteral("big"), &client));
+    QVERIFY(menu);
+    QCOMPARE(menu->actions().count(), 2 * actionCount);
+    QCOMPARE(menu->actions().at(actionCount / 2), actionList.first());
+    QCOMPARE(menu->actions().at(actionCount / 2 + actionCount - 1), actionList.last());
+}
+
+void tst_KXmlGuiBenchmark::benchmarkReplaceActionList_data()
+{
+    QTest::addColumn<int>("actionCount");
+    QTest::addColumn<bool>("replace");
+
+    Q_FOREACH (int actionCount, QList<int>() << 10 << 100 << 1000) {
+        QTest::newRow(qPrintable(QStringLiteral("unplug+plug, %1 actions").arg(actionCount))) << actionCount << false;
+        QTest::newRow(qPrintable(QStringLiteral("replace, %1 actions").arg(actionCount))) << actionCount << true;
+    }
+}
+
+// Refreshing a list like "Recent Files" after opening the least recent file again:
+// one action moves from the bottom to the top.
+void tst_KXmlGuiBenchmark::benchmarkReplaceActionList()
+{
+    QFETCH(int, actionCount);
+    QFETCH(bool, replace);
+
+    TestGuiClient client(generateMenuRcFile(actionCount));
+    client.createActions(actionNames(actionCount));
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+    factory.addClient(&client);
+
+    QList<QAction *> actionList;
+    for (int i = 0; i < actionCount; ++i) {
+        QAction *action = new QAction(QStringLiteral("Recent file"), &mainWindow);
+        action->setObjectName(QStringLiteral("recent%1").arg(i));
+        actionList.append(action);
+    }
+
+    client.plugActionList(QStringLiteral("list"), actionList);
+    QBENCHMARK {
+        actionList.prepend(actionList.takeLast());
+        if (replace) {
+            client.replaceActionList(QStringLiteral("list"), actionList);
+        } else {
+            client.unplugActionList(QStringLiteral("list"));
+            client.plugActionList(QStringLiteral("list"), actionList);
+        }
+    }
+
+    QMenu *menu = qobject_cast<QMenu *>(factory.container(QStringLiteral("big"), &client));
+    QVERIFY(menu);
+    QCOMPARE(menu->actions().count(), 2 * actionCount);
+    QCOMPARE(menu->actions().mid(actionCount / 2, actionCount), actionList);
+}
+
+void tst_KXmlGuiBenchmark::benchmarkSetXML_data()
+{
+    addRcFileSizeRows();
+}
+
+void tst_KXmlGuiBenchmark::benchmarkSetXML()
+{
+    QFETCH(int, actionCount);
+    const QString xml = QString::fromUtf8(generateRcFile(actionCount));
+
+    TestGuiClient client;
+    QBENCHMARK {
+        client.setXMLPublic(xml);
+    }
+    QCOMPARE(client.domDocument().documentElement().attribute(QStringLiteral("name")), QStringLiteral("benchmark"));
+}
+
+void tst_KXmlGuiBenchmark::benchmarkMergeXML_data()
+{
+    addRcFileSizeRows();
+}
+
+void tst_KXmlGuiBenchmark::benchmarkMergeXML()
+{
+    QFETCH(int, actionCount);
+    const QDomDocument base = loadWithStreamReader(generateRcFile(actionCount));
+    const QDomDocument part = loadWithStreamReader(generatePartRcFile(actionCount));
+
+    TestGuiClient client;
+    client.createActions(rcFileActionNames(actionCount));
+    client.createActions(QStringList() << QStringLiteral("partaction0"));
+
+    // merging modifies both documents, so it works on copies
+    QDomDocument baseCopy = base.cloneNode(true).toDocument();
+    QDomDocument partCopy = part.cloneNode(true).toDocument();
+    benchmarkStep(actionCount, [&]() {
+        client.setDOMDocumentPublic(baseCopy);
+        client.setDOMDocumentPublic(partCopy, true);
+    }, [&]() {
+        baseCopy = base.cloneNode(true).toDocument();
+        partCopy = part.cloneNode(true).toDocument();
+    });
+
+    client.setDOMDocumentPublic(baseCopy);
+    client.setDOMDocumentPublic(partCopy, true);
+    const QDomElement toolBar = client.domDocument().documentElement().firstChildElement(QStringLiteral("ToolBar"));
+    QCOMPARE(toolBar.attribute(QStringLiteral("name")), QStringLiteral("toolBar0"));
+    QCOMPARE(toolBar.lastChildElement(QStringLiteral("Action")).attribute(QStringLiteral("name")), QStringLiteral("partaction0"));
+}
+
+void tst_KXmlGuiBenchmark::benchmarkAddClient_data()
+{
+    addRcFileSizeRows();
+}
+
+void tst_KXmlGuiBenchmark::benchmarkAddClient()
+{
+    QFETCH(int, actionCount);
+
+    TestGuiClient client(generateRcFile(actionCount));
+    client.createActions(rcFileActionNames(actionCount));
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+
+    benchmarkStep(actionCount, [&]() {
+        factory.addClient(&client);
+    }, [&]() {
+        factory.removeClient(&client);
+    });
+
+    factory.addClient(&client);
+    QVERIFY(factory.container(QStringLiteral("menu0"), &client));
+    QVERIFY(factory.container(QStringLiteral("toolBar2"), &client));
+}
+
+void tst_KXmlGuiBenchmark::benchmarkRemoveClient_data()
+{
+    addRcFileSizeRows();
+}
+
+void tst_KXmlGuiBenchmark::benchmarkRemoveClient()
+{
+    QFETCH(int, actionCount);
+
+    TestGuiClient client(generateRcFile(actionCount));
+    client.createActions(rcFileActionNames(actionCount));
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+    factory.addClient(&client);
+
+    benchmarkStep(actionCount, [&]() {
+        factory.removeClient(&client);
+    }, [&]() {
+        factory.addClient(&client);
+    });
+
+    factory.removeClient(&client);
+    QVERIFY(!factory.container(QStringLiteral("menu0"), &client));
+    QVERIFY(factory.clients().isEmpty());
+}
+
+void tst_KXmlGuiBenchmark::benchmarkEditToolBarLoad_data()
+{
+    addRcFileSizeRows();
+}
+
+void tst_KXmlGuiBenchmark::benchmarkEditToolBarLoad()
+{
+    QFETCH(int, actionCount);
+
+    // KEditToolBar only edits clients with an xmlgui file
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write(generateRcFile(actionCount));
+    file.close();
+
+    TestGuiClient client;
+    client.createActions(rcFileActionNames(actionCount));
+    client.setXMLFilePublic(file.fileName());
+    KMainWindow mainWindow;
+    KXMLGUIBuilder builder(&mainWindow);
+    KXMLGUIFactory factory(&builder);
+    factory.addClient(&client);
+
+    QBENCHMARK {
+        KEditToolBar editToolBar(&factory);
+        // KEditToolBar loads the toolbars in showEvent
+        QShowEvent showEvent;
+        QCoreApplication::sendEvent(&editToolBar, &showEvent);
+        QHideEvent hideEvent;
+        QCoreApplication::sendEvent(&editToolBar, &hideEvent);
+    }
+}
+
+#include "kxmlguibenchmark.moc"
@@ -0,0 +1,191 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include <QTest>
+#include <QDebug>
+
+#include <kxmlguiloader.cpp> // it's not exported, so we need to include the code here
+
+#include "rcfilegenerator.h"
+
+#include <atomic>
+
+// Heap accounting, to compare the number of allocations and the peak heap usage
+// of the different ways to load a document. It replaces malloc and friends, since
+// most of the memory (QString, QByteArray, QList, ...) doesn't come from operator new.
+// This is a test of its own so that the other benchmarks don't pay for it.
+#if defined(__GLIBC__)
+#define KXMLGUI_COUNT_HEAP 1
+
+#include <malloc.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+}
+
+// Only counting while a HeapRecorder is alive
+static std::atomic<bool> s_counting(false);
+static std::atomic<qint64> s_allocationCount(0);
+static std::atomic<qint64> s_heapUsage(0);
+static std::atomic<qint64> s_peakHeapUsage(0);
+
+static void countAllocation(void *ptr, bool newAllocation)
+{
+    if (!ptr || !s_counting.load(std::memory_order_relaxed)) {
+        return;
+    }
+    if (newAllocation) {
+        ++s_allocationCount;
+    }
+    const qint64 usage = s_heapUsage += malloc_usable_size(ptr);
+    qint64 peak = s_peakHeapUsage.load();
+    while (usage > peak && !s_peakHeapUsage.compare_exchange_weak(peak, usage)) {
+    }
+}
+
+static void countFree(void *ptr)
+{
+    if (ptr && s_counting.load(std::memory_order_relaxed)) {
+        s_heapUsage -= malloc_usable_size(ptr);
+    }
+}
+
+extern "C" {
+void *malloc(size_t size)
+{
+    void *ptr = __libc_malloc(size);
+    countAllocation(ptr, true);
+    return ptr;
+}
+
+void *calloc(size_t count, size_t size)
+{
+    void *ptr = __libc_calloc(count, size);
+    countAllocation(ptr, true);
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    countFree(ptr);
+    void *newPtr = __libc_realloc(ptr, size);
+    if (newPtr) {
+        countAllocation(newPtr, !ptr);
+    } else if (size) {
+        countAllocation(ptr, false); // failed, the old block is still there
+    }
+    return newPtr;
+}
+
+void free(void *ptr)
+{
+    countFree(ptr);
+    __libc_free(ptr);
+}
+}
+#endif
+
+struct HeapUsage {
+    qint64 allocations;
+    qint64 peak;
+};
+
+class HeapRecorder
+{
+public:
+    HeapRecorder()
+    {
+#ifdef KXMLGUI_COUNT_HEAP
+        s_allocationCount = 0;
+        s_heapUsage = 0;
+        s_peakHeapUsage = 0;
+        s_counting = true;
+#endif
+    }
+    ~HeapRecorder()
+    {
+#ifdef KXMLGUI_COUNT_HEAP
+        s_counting = false;
+#endif
+    }
+    HeapUsage result() const
+    {
+        HeapUsage usage = { 0, 0 };
+#ifdef KXMLGUI_COUNT_HEAP
+        usage.allocations = s_allocationCount.load();
+        usage.peak = s_peakHeapUsage.load();
+#endif
+        return usage;
+    }
+};
+
+class tst_KXmlGuiLoaderHeap : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testLoadHeapUsage_data();
+    void testLoadHeapUsage();
+};
+
+QTEST_MAIN(tst_KXmlGuiLoaderHeap)
+
+void tst_KXmlGuiLoaderHeap::testLoadHeapUsage_data()
+{
+    QTest::addColumn<int>("actionCount");
+
+    QTest::newRow("100 actions") << 100;
+    QTest::newRow("1000 actions") << 1000;
+    QTest::newRow("10000 actions") << 10000;
+}
+
+void tst_KXmlGuiLoaderHeap::testLoadHeapUsage()
+{
+#ifndef KXMLGUI_COUNT_HEAP
+    QSKIP("Counting the allocations needs glibc");
+#endif
+    QFETCH(int, actionCount);
+    const QByteArray xml = generateRcFile(actionCount);
+
+    HeapUsage dom;
+    {
+        HeapRecorder recorder;
+        const QDomDocument doc = loadWithDom(xml);
+        dom = recorder.result();
+    }
+    HeapUsage streaming;
+    {
+        HeapRecorder recorder;
+        const QDomDocument doc = loadWithStreamReader(xml);
+        streaming = recorder.result();
+    }
+
+    qDebug() << "file size:" << xml.size() << "bytes";
+    qDebug() << "setContent:    " << dom.allocations << "allocations," << dom.peak << "bytes peak heap";
+    qDebug() << "stream reader: " << streaming.allocations << "allocations," << streaming.peak << "bytes peak heap";
+
+    QVERIFY(dom.allocations > 0);
+    QVERIFY2(streaming.allocations < dom.allocations,
+             qPrintable(QStringLiteral("%1 allocations with the stream reader, %2 with setContent")
+                        .arg(streaming.allocations).arg(dom.allocations)));
+}
+
+#include "kxmlguiloaderheaptest.moc"
@@ -0,0 +1,114 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef RCFILEGENERATOR_H
+#define RCFILEGENERATOR_H
+
+#include <QDomDocument>
+#include <QStringList>
+
+#include "kxmlguiloader_p.h"
+
+// Shared by the benchmarks and the heap usage test of the xmlgui loader.
+// The loader isn't exported, the including file needs to include kxmlguiloader.cpp.
+
+inline QStringList textTagNames()
+{
+    return QStringList() << QStringLiteral("text") << QStringLiteral("Text") << QStringLiteral("title");
+}
+
+static const QString s_domain = QStringLiteral("kxmlguibenchmark");
+
+// Generates an xmlgui file with @p actionCount actions, spread over nested menus
+// and a few toolbars, similar to the files of large applications.
+inline QByteArray generateRcFile(int actionCount)
+{
+    QByteArray xml =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<!DOCTYPE gui SYSTEM \"kpartgui.dtd\">\n"
+        "<gui name=\"benchmark\" version=\"42\">\n"
+        " <MenuBar>\n";
+    const int actionsPerMenu = 20;
+    int action = 0;
+    for (int menu = 0; action < actionCount; ++menu) {
+        xml += "  <Menu name=\"menu" + QByteArray::number(menu) + "\">\n"
+               "   <text>Menu &amp;" + QByteArray::number(menu) + "</text>\n";
+        for (int i = 0; i < actionsPerMenu && action < actionCount; ++i, ++action) {
+            if (i == actionsPerMenu / 2) {
+                xml += "   <Separator/>\n"
+                       "   <Menu name=\"submenu" + QByteArray::number(menu) + "\" icon=\"document-open\">\n"
+                       "    <text context=\"@title:menu\">Submenu " + QByteArray::number(menu) + "</text>\n"
+                       "    <Action name=\"subaction" + QByteArray::number(action) + "\"/>\n"
+                       "    <ActionList name=\"list" + QByteArray::number(menu) + "\"/>\n"
+                       "   </Menu>\n";
+            }
+            xml += "   <Action name=\"action" + QByteArray::number(action) + "\"/>\n";
+        }
+        xml += "   <Merge/>\n"
+               "  </Menu>\n";
+    }
+    xml += " </MenuBar>\n";
+    for (int toolBar = 0; toolBar < 3; ++toolBar) {
+        xml += " <ToolBar name=\"toolBar" + QByteArray::number(toolBar) + "\" noMerge=\"1\">\n"
+               "  <text translationDomain=\"other\">Tool Bar " + QByteArray::number(toolBar) + "</text>\n";
+        for (int i = toolBar; i < actionCount; i += 50) {
+            xml += "  <Action name=\"action" + QByteArray::number(i) + "\"/>\n";
+        }
+        xml += " </ToolBar>\n";
+    }
+    xml += " <ActionProperties scheme=\"Default\">\n";
+    for (int i = 0; i < actionCount; i += 10) {
+        xml += "  <Action name=\"action" + QByteArray::number(i) + "\" shortcut=\"Ctrl+Shift+F" + QByteArray::number(i % 12 + 1) + "\"/>\n";
+    }
+    xml += " </ActionProperties>\n"
+           "</gui>\n";
+    return xml;
+}
+
+// What KXMLGUIClient::setXML used to do: decode, parse with QDomDocument,
+// then look up all text elements to store the translation domain in them.
+inline QDomDocument loadWithDom(const QByteArray &data)
+{
+    QDomDocument doc;
+    doc.setContent(QString::fromUtf8(data));
+    const QLatin1String attrDomain("translationDomain");
+    QDomElement base = doc.documentElement();
+    QString domain = base.attribute(attrDomain);
+    if (domain.isEmpty()) {
+        domain = s_domain;
+    }
+    Q_FOREACH (const QString &tagName, textTagNames()) {
+        QDomNodeList textNodes = base.elementsByTagName(tagName);
+        for (int i = 0; i < textNodes.length(); ++i) {
+            QDomElement e = textNodes.item(i).toElement();
+            if (e.attribute(attrDomain).isEmpty()) {
+                e.setAttribute(attrDomain, domain);
+            }
+        }
+    }
+    return doc;
+}
+
+inline QDomDocument loadWithStreamReader(const QByteArray &data)
+{
+    QDomDocument doc;
+    KXmlGuiLoader::load(data, doc, s_domain, textTagNames());
+    return doc;
+}
+
+#endif // RCFILEGENERATOR_H
@@ -41,6 +41,14 @@ public:
     {
         setXMLFile(file, merge, setXMLDoc);
     }
+    void setXMLPublic(const QString &document, bool merge = false)
+    {
+        setXML(document, merge);
+    }
+    void setDOMDocumentPublic(const QDomDocument &document, bool merge = false)
+    {
+        setDOMDocument(document, merge);
+    }
     void createGUI(const QByteArray &xml, bool withUiStandards = false)
     {
         if (withUiStandards) {
@@ -95,6 +95,9 @@ void KActionCategory::addAction(QAction *action)
     // Only add the action if wasn't added earlier.
     if (!d->actions.contains(action)) {
         d->actions.append(action);
+        if (KActionCollection *actionCollection = collection()) {
+            actionCollection->addActionToCategory(action, this);
+        }
     }
 }
 
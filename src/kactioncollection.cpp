@@ -37,16 +37,23 @@
 #include <kconfiggroup.h>
 #if HAVE_GLOBALACCEL
 # include <kglobalaccel.h>
+# include <kglobalshortcutinfo.h>
+# include <QDBusConnection>
+# include <QDBusMessage>
+# include <QDBusObjectPath>
+# include <QDBusReply>
 #endif
 #include <ksharedconfig.h>
 
 #include <QDomDocument>
 #include <QSet>
 #include <QGuiApplication>
+#include <QHash>
 #include <QMap>
 #include <QList>
 #include <QAction>
 #include <QMetaMethod>
+#include <QPointer>
 
 #include <stdio.h>
 
@@ -54,7 +61,9 @@ class KActionCollectionPrivate
 {
 public:
     KActionCollectionPrivate()
-        : m_parentGUIClient(nullptr),
+        : nextSequence(0),
+          actionsListValid(true),
+          m_parentGUIClient(nullptr),
           configGroup(QStringLiteral("Shortcuts")),
           configIsGlobal(false),
           connectTriggered(false),
@@ -82,17 +91,64 @@ public:
     void _k_associatedWidgetDestroyed(QObject *obj);
     void _k_actionDestroyed(QObject *obj);
 
-    bool writeKXMLGUIConfigFile();
+    //! Whether writeSettings() without a config group saves to the kxmlgui file
+    bool usesKXMLGUIConfigFile() const;
+    //! @p onlyChanged: only write the shortcuts which changed since they were last saved
+    bool writeKXMLGUIConfigFile(bool onlyChanged);
+
+    //! Whether the default storage (see writeSettings()) has the current shortcuts of @p action
+    bool shortcutsSaved(QAction *action) const;
+    void setShortcutsSaved(QAction *action);
+    void forgetSavedShortcuts();
+
+#if HAVE_GLOBALACCEL
+    //! The global shortcuts kglobalaccel has registered for the component of this
+    //! collection, by action name. Two D-Bus calls rather than one per action.
+    QHash<QString, QList<QKeySequence> > registeredGlobalShortcuts() const;
+#endif
 
     QString m_componentName;
     QString m_componentDisplayName;
 
+    //! Register an action under @p name (see KActionCollection::addAction), but don't
+    //! add it to the associated widgets or emit signals. Returns false if it was
+    //! already registered under that name.
+    bool registerAction(const QString &name, QAction *action);
+
+    //! Add an action to our internal bookkeeping, after all the others.
+    void listAction(const QString &name, QAction *action);
+
     //! Remove a action from our internal bookkeeping. Returns a nullptr if the
     //! action doesn't belong to us.
     QAction *unlistAction(QAction *);
 
-    QMap<QString, QAction *> actionByName;
-    QList<QAction *> actions;
+    //! The actions in the order they were added.
+    const QList<QAction *> &orderedActions() const;
+
+    struct ActionEntry {
+        ActionEntry() : sequence(0), saved(false) {}
+        QString name;
+        quint64 sequence;
+        // The shortcuts in the default storage, if known, and the defaults they were
+        // compared against: an entry equal to the default isn't stored at all
+        QList<QKeySequence> savedShortcuts;
+        QList<QKeySequence> savedDefaultShortcuts;
+        bool saved;
+        // The categories the action is in, so that removing it doesn't need to look for them
+        QList<QPointer<KActionCategory> > categories;
+    };
+
+    // Looked up for every action element while building the GUI, and for every state change.
+    // Those names are fresh copies, so each lookup hashes the name and compares it once.
+    QHash<QString, QAction *> actionByName;
+    // Reverse index, so that adding and removing actions doesn't need to search for them
+    QHash<QAction *, ActionEntry> actionEntries;
+    // The actions by insertion sequence number, i.e. in order
+    QMap<quint64, QAction *> actionsBySequence;
+    quint64 nextSequence;
+    // actionsBySequence as a list, for actions(); rebuilt when needed
+    mutable QList<QAction *> actionsList;
+    mutable bool actionsListValid;
 
     const KXMLGUIClient *m_parentGUIClient;
 
@@ -139,9 +195,14 @@ KActionCollection::~KActionCollection()
 
 void KActionCollection::clear()
 {
+    // deleting an action unlists it
+    const QList<QAction *> actions = d->orderedActions();
+    qDeleteAll(actions);
     d->actionByName.clear();
-    qDeleteAll(d->actions);
-    d->actions.clear();
+    d->actionEntries.clear();
+    d->actionsBySequence.clear();
+    d->actionsList.clear();
+    d->actionsListValid = true;
 }
 
 QAction *KActionCollection::action(const QString &name) const
@@ -163,7 +224,7 @@ QAction *KActionCollection::action(int index) const
 
 int KActionCollection::count() const
 {
-    return d->actions.count();
+    return d->actionEntries.count();
 }
 
 bool KActionCollection::isEmpty() const
@@ -218,13 +279,13 @@ const KXMLGUIClient *KActionCollection::parentGUIClient() const
 
 QList<QAction *> KActionCollection::actions() const
 {
-    return d->actions;
+    return d->orderedActions();
 }
 
 const QList< QAction * > KActionCollection::actionsWithoutGroup() const
 {
     QList<QAction *> ret;
-    Q_FOREACH (QAction *action, d->actions)
+    Q_FOREACH (QAction *action, d->orderedActions())
         if (!action->actionGroup()) {
             ret.append(action);
         }
@@ -234,19 +295,15 @@ const QList< QAction * > KActionCollection::actionsWithoutGroup() const
 const QList< QActionGroup * > KActionCollection::actionGroups() const
 {
     QSet<QActionGroup *> set;
-    Q_FOREACH (QAction *action, d->actions)
+    Q_FOREACH (QAction *action, d->orderedActions())
         if (action->actionGroup()) {
             set.insert(action->actionGroup());
         }
     return set.toList();
 }
 
-QAction *KActionCollection::addAction(const QString &name, QAction *action)
+bool KActionCollectionPrivate::registerAction(const QString &name, QAction *action)
 {
-    if (!action) {
-        return action;
-    }
-
     const QString objectName = action->objectName();
     QString indexName = name;
 
@@ -290,10 +347,10 @@ QAction *KActionCollection::addAction(const QString &name, QAction *action)
     Q_ASSERT(!action->objectName().isEmpty());
 
     // look if we already have THIS action under THIS name ;)
-    if (d->actionByName.value(indexName, nullptr) == action) {
+    if (actionByName.value(indexName, nullptr) == action) {
         // This is not a multi map!
-        Q_ASSERT(d->actionByName.count(indexName) == 1);
-        return action;
+        Q_ASSERT(actionByName.count(indexName) == 1);
+        return false;
     }
 
     if (!KAuthorized::authorizeAction(indexName)) {
@@ -304,48 +361,94 @@ QAction *KActionCollection::addAction(const QString &name, QAction *action)
     }
 
     // Check if we have another action under this name
-    if (QAction *oldAction = d->actionByName.value(indexName)) {
-        takeAction(oldAction);
+    if (QAction *oldAction = actionByName.value(indexName)) {
+        q->takeAction(oldAction);
     }
 
     // Check if we have this action under a different name.
     // Not using takeAction because we don't want to remove it from categories,
     // and because it has the new name already.
-    const int oldIndex = d->actions.indexOf(action);
-    if (oldIndex != -1) {
-        d->actionByName.remove(d->actionByName.key(action));
-        d->actions.removeAt(oldIndex);
+    QList<QPointer<KActionCategory> > categories;
+    QHash<QAction *, ActionEntry>::iterator entryIt = actionEntries.find(action);
+    if (entryIt != actionEntries.end()) {
+        categories = entryIt->categories;
+        actionByName.remove(entryIt->name);
+        actionsBySequence.remove(entryIt->sequence);
+        actionEntries.erase(entryIt);
+        actionsListValid = false;
     }
 
     // Add action to our lists.
-    d->actionByName.insert(indexName, action);
-    d->actions.append(action);
+    listAction(indexName, action);
+    actionEntries[action].categories = categories;
 
-    Q_FOREACH (QWidget *widget, d->associatedWidgets) {
-        widget->addAction(action);
+    QObject::connect(action, SIGNAL(destroyed(QObject*)), q, SLOT(_k_actionDestroyed(QObject*)));
+
+    setComponentForAction(action);
+
+    if (connectHovered) {
+        QObject::connect(action, SIGNAL(hovered()), q, SLOT(slotActionHovered()));
     }
 
-    connect(action, SIGNAL(destroyed(QObject*)), SLOT(_k_actionDestroyed(QObject*)));
+    if (connectTriggered) {
+        QObject::connect(action, SIGNAL(triggered(bool)), q, SLOT(slotActionTriggered()));
+    }
+
+    return true;
+}
 
-    d->setComponentForAction(action);
+QAction *KActionCollection::addAction(const QString &name, QAction *action)
+{
+    if (!action) {
+        return action;
+    }
 
-    if (d->connectHovered) {
-        connect(action, SIGNAL(hovered()), SLOT(slotActionHovered()));
+    if (!d->registerAction(name, action)) {
+        return action;
     }
 
-    if (d->connectTriggered) {
-        connect(action, SIGNAL(triggered(bool)), SLOT(slotActionTriggered()));
+    Q_FOREACH (QWidget *widget, d->associatedWidgets) {
+        widget->addAction(action);
     }
 
     emit inserted(action);
+    emit actionsInserted(QList<QAction *>() << action);
     return action;
 }
 
 void KActionCollection::addActions(const QList<QAction *> &actions)
 {
+    // Register all the actions first, then tell the associated widgets and
+    // the listeners about them at once
+    QList<QAction *> registered;
+    registered.reserve(actions.count());
+    d->actionByName.reserve(d->actionByName.count() + actions.count());
     Q_FOREACH (QAction *action, actions) {
-        addAction(action->objectName(), action);
+        if (action && d->registerAction(action->objectName(), action)) {
+            registered.append(action);
+        }
+    }
+
+    // An action might have replaced another one of the list with the same name
+    QList<QAction *> added;
+    added.reserve(registered.count());
+    Q_FOREACH (QAction *action, registered) {
+        if (d->actionEntries.contains(action)) {
+            added.append(action);
+        }
+    }
+    if (added.isEmpty()) {
+        return;
     }
+
+    Q_FOREACH (QWidget *widget, d->associatedWidgets) {
+        widget->addActions(added);
+    }
+
+    Q_FOREACH (QAction *action, added) {
+        emit inserted(action);
+    }
+    emit actionsInserted(added);
 }
 
 void KActionCollection::removeAction(QAction *action)
@@ -353,6 +456,18 @@ void KActionCollection::removeAction(QAction *action)
     delete takeAction(action);
 }
 
+void KActionCollection::removeActions(const QList<QAction *> &actions)
+{
+    QList<QAction *> taken;
+    taken.reserve(actions.count());
+    Q_FOREACH (QAction *action, actions) {
+        if (QAction *takenAction = takeAction(action)) {
+            taken.append(takenAction);
+        }
+    }
+    qDeleteAll(taken);
+}
+
 QAction *KActionCollection::takeAction(QAction *action)
 {
     if (!d->unlistAction(action)) {
@@ -441,6 +556,9 @@ QString KActionCollection::configGroup() const
 
 void KActionCollection::setConfigGroup(const QString &group)
 {
+    if (d->configGroup != group) {
+        d->forgetSavedShortcuts();
+    }
     d->configGroup = group;
 }
 
@@ -451,6 +569,9 @@ bool KActionCollection::configIsGlobal() const
 
 void KActionCollection::setConfigGlobal(bool global)
 {
+    if (d->configIsGlobal != global) {
+        d->forgetSavedShortcuts();
+    }
     d->configIsGlobal = global;
 }
 
@@ -462,7 +583,11 @@ void KActionCollection::importGlobalShortcuts(KConfigGroup *config)
         return;
     }
 
-    for (QMap<QString, QAction *>::ConstIterator it = d->actionByName.constBegin();
+    KGlobalAccel *globalAccel = KGlobalAccel::self();
+    // what kglobalaccel has now, fetched once when first needed
+    QHash<QString, QList<QKeySequence> > registered;
+    bool fetched = false;
+    for (QHash<QString, QAction *>::ConstIterator it = d->actionByName.constBegin();
             it != d->actionByName.constEnd(); ++it) {
         QAction *action = it.value();
         if (!action) {
@@ -473,12 +598,21 @@ void KActionCollection::importGlobalShortcuts(KConfigGroup *config)
 
         if (isShortcutsConfigurable(action)) {
             QString entry = config->readEntry(actionName, QString());
-            if (!entry.isEmpty()) {
-                KGlobalAccel::self()->setShortcut(action, QKeySequence::listFromString(entry), KGlobalAccel::NoAutoloading);
-            } else {
-                QList<QKeySequence> defaultShortcut = KGlobalAccel::self()->defaultShortcut(action);
-                KGlobalAccel::self()->setShortcut(action, defaultShortcut, KGlobalAccel::NoAutoloading);
+            const QList<QKeySequence> shortcut = !entry.isEmpty() ? QKeySequence::listFromString(entry)
+                                                 : globalAccel->defaultShortcut(action);
+            // Setting a shortcut is a blocking call to kglobalaccel, skip those which wouldn't
+            // change. Actions which aren't registered in this process yet need it in any case.
+            if (globalAccel->hasShortcut(action)) {
+                if (!fetched) {
+                    registered = d->registeredGlobalShortcuts();
+                    fetched = true;
+                }
+                QHash<QString, QList<QKeySequence> >::const_iterator current = registered.constFind(action->objectName());
+                if (current != registered.constEnd() && current.value() == shortcut) {
+                    continue;
+                }
             }
+            globalAccel->setShortcut(action, shortcut, KGlobalAccel::NoAutoloading);
         }
     }
 #else
@@ -486,8 +620,45 @@ void KActionCollection::importGlobalShortcuts(KConfigGroup *config)
 #endif
 }
 
+#if HAVE_GLOBALACCEL
+QHash<QString, QList<QKeySequence> > KActionCollectionPrivate::registeredGlobalShortcuts() const
+{
+    QHash<QString, QList<QKeySequence> > shortcuts;
+    // registers the D-Bus types of kglobalaccel
+    KGlobalAccel::self();
+
+    const QString service = QStringLiteral("org.kde.kglobalaccel");
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    QDBusMessage call = QDBusMessage::createMethodCall(service, QStringLiteral("/kglobalaccel"),
+                                                       QStringLiteral("org.kde.KGlobalAccel"),
+                                                       QStringLiteral("getComponent"));
+    call << m_componentName;
+    const QDBusReply<QDBusObjectPath> component = bus.call(call);
+    if (!component.isValid()) {
+        // nothing registered for the component yet
+        return shortcuts;
+    }
+
+    call = QDBusMessage::createMethodCall(service, component.value().path(),
+                                          QStringLiteral("org.kde.kglobalaccel.Component"),
+                                          QStringLiteral("allShortcutInfos"));
+    const QDBusReply<QList<KGlobalShortcutInfo> > infos = bus.call(call);
+    if (!infos.isValid()) {
+        qCWarning(DEBUG_KXMLGUI) << "Cannot get the global shortcuts of" << m_componentName << infos.error().message();
+        return shortcuts;
+    }
+    Q_FOREACH (const KGlobalShortcutInfo &info, infos.value()) {
+        shortcuts.insert(info.uniqueName(), info.keys());
+    }
+    return shortcuts;
+}
+#endif
+
 void KActionCollection::readSettings(KConfigGroup *config)
 {
+    // Reading the group writeSettings() saves to, remember what it has
+    const bool defaultStorage = !config && !d->usesKXMLGUIConfigFile();
+
     KConfigGroup cg(KSharedConfig::openConfig(), configGroup());
     if (!config) {
         config = &cg;
@@ -497,7 +668,7 @@ void KActionCollection::readSettings(KConfigGroup *config)
         return;
     }
 
-    for (QMap<QString, QAction *>::ConstIterator it = d->actionByName.constBegin();
+    for (QHash<QString, QAction *>::ConstIterator it = d->actionByName.constBegin();
             it != d->actionByName.constEnd(); ++it) {
         QAction *action = it.value();
         if (!action) {
@@ -507,10 +678,13 @@ void KActionCollection::readSettings(KConfigGroup *config)
         if (isShortcutsConfigurable(action)) {
             QString actionName = it.key();
             QString entry = config->readEntry(actionName, QString());
-            if (!entry.isEmpty()) {
-                action->setShortcuts(QKeySequence::listFromString(entry));
-            } else {
-                action->setShortcuts(defaultShortcuts(action));
+            const QList<QKeySequence> shortcuts = !entry.isEmpty() ? QKeySequence::listFromString(entry)
+                                                  : defaultShortcuts(action);
+            if (action->shortcuts() != shortcuts) {
+                action->setShortcuts(shortcuts);
+            }
+            if (defaultStorage) {
+                d->setShortcutsSaved(action);
             }
         }
     }
@@ -526,9 +700,8 @@ void KActionCollection::exportGlobalShortcuts(KConfigGroup *config, bool writeAl
         return;
     }
 
-    QList<QAction *> writeActions = actions();
-
-    for (QMap<QString, QAction *>::ConstIterator it = d->actionByName.constBegin();
+    KGlobalAccel *globalAccel = KGlobalAccel::self();
+    for (QHash<QString, QAction *>::ConstIterator it = d->actionByName.constBegin();
             it != d->actionByName.constEnd(); ++it) {
 
         QAction *action = it.value();
@@ -544,9 +717,9 @@ void KActionCollection::exportGlobalShortcuts(KConfigGroup *config, bool writeAl
             continue;
         }
 
-        if (isShortcutsConfigurable(action) && KGlobalAccel::self()->hasShortcut(action)) {
-            bool bConfigHasAction = !config->readEntry(actionName, QString()).isEmpty();
-            bool bSameAsDefault = (KGlobalAccel::self()->shortcut(action) == KGlobalAccel::self()->defaultShortcut(action));
+        if (isShortcutsConfigurable(action) && globalAccel->hasShortcut(action)) {
+            const QList<QKeySequence> shortcut = globalAccel->shortcut(action);
+            bool bSameAsDefault = (shortcut == globalAccel->defaultShortcut(action));
             // If we're using a global config or this setting
             //  differs from the default, then we want to write.
             KConfigGroup::WriteConfigFlags flags = KConfigGroup::Persistent;
@@ -554,7 +727,7 @@ void KActionCollection::exportGlobalShortcuts(KConfigGroup *config, bool writeAl
                 flags |= KConfigGroup::Global;
             }
             if (writeAll || !bSameAsDefault) {
-                QString s = QKeySequence::listToString(KGlobalAccel::self()->shortcut(action));
+                QString s = QKeySequence::listToString(shortcut);
                 if (s.isEmpty()) {
                     s = QStringLiteral("none");
                 }
@@ -563,7 +736,7 @@ void KActionCollection::exportGlobalShortcuts(KConfigGroup *config, bool writeAl
             }
             // Otherwise, this key is the same as default
             //  but exists in config file.  Remove it.
-            else if (bConfigHasAction) {
+            else if (!config->readEntry(actionName, QString()).isEmpty()) {
                 qCDebug(DEBUG_KXMLGUI) << "\tremoving " << actionName << " because == default";
                 config->deleteEntry(actionName, flags);
             }
@@ -577,13 +750,32 @@ void KActionCollection::exportGlobalShortcuts(KConfigGroup *config, bool writeAl
 #endif
 }
 
-bool KActionCollectionPrivate::writeKXMLGUIConfigFile()
+bool KActionCollectionPrivate::usesKXMLGUIConfigFile() const
 {
     const KXMLGUIClient *kxmlguiClient = q->parentGUIClient();
+    return kxmlguiClient && !kxmlguiClient->xmlFile().isEmpty();
+}
+
+bool KActionCollectionPrivate::writeKXMLGUIConfigFile(bool onlyChanged)
+{
     // return false if there is no KXMLGUIClient
-    if (!kxmlguiClient || kxmlguiClient->xmlFile().isEmpty()) {
+    if (!usesKXMLGUIConfigFile()) {
         return false;
     }
+    const KXMLGUIClient *kxmlguiClient = q->parentGUIClient();
+
+    // the actions to write, sorted by name so that the file doesn't change needlessly
+    QStringList actionNames;
+    for (QHash<QString, QAction *>::ConstIterator it = actionByName.constBegin(); it != actionByName.constEnd(); ++it) {
+        if (it.value() && (!onlyChanged || !shortcutsSaved(it.value()))) {
+            actionNames.append(it.key());
+        }
+    }
+    if (actionNames.isEmpty()) {
+        // the file is up to date, don't even read it
+        return true;
+    }
+    actionNames.sort();
 
     qCDebug(DEBUG_KXMLGUI) << "xmlFile=" << kxmlguiClient->xmlFile();
 
@@ -600,14 +792,8 @@ bool KActionCollectionPrivate::writeKXMLGUIConfigFile()
     QDomElement elem = KXMLGUIFactory::actionPropertiesElement(doc);
 
     // now, iterate through our actions
-    for (QMap<QString, QAction *>::ConstIterator it = actionByName.constBegin();
-            it != actionByName.constEnd(); ++it) {
-        QAction *action = it.value();
-        if (!action) {
-            continue;
-        }
-
-        QString actionName = it.key();
+    Q_FOREACH (const QString &actionName, actionNames) {
+        QAction *action = actionByName.value(actionName);
 
         // If the action name starts with unnamed- spit out a warning and ignore
         // it. That name will change at will and will break loading writing
@@ -643,15 +829,23 @@ bool KActionCollectionPrivate::writeKXMLGUIConfigFile()
     }
 
     // Write back to XML file
-    KXMLGUIFactory::saveConfigFile(doc, kxmlguiClient->localXMLFile(), q->componentName());
+    if (KXMLGUIFactory::saveConfigFile(doc, kxmlguiClient->localXMLFile(), q->componentName())) {
+        Q_FOREACH (const QString &actionName, actionNames) {
+            setShortcutsSaved(actionByName.value(actionName));
+        }
+    }
     return true;
 }
 
 void KActionCollection::writeSettings(KConfigGroup *config, bool writeAll, QAction *oneAction) const
 {
+    // Without a config group we save to the default storage, so we know which
+    // shortcuts it has already and only need to write those which changed
+    const bool defaultStorage = !config;
+
     // If the caller didn't provide a config group we try to save the KXMLGUI
     // Configuration file. If that succeeds we are finished.
-    if (config == nullptr && d->writeKXMLGUIConfigFile()) {
+    if (config == nullptr && d->writeKXMLGUIConfigFile(true /*onlyChanged*/)) {
         return;
     }
 
@@ -667,15 +861,12 @@ void KActionCollection::writeSettings(KConfigGroup *config, bool writeAll, QActi
         writeActions = actions();
     }
 
-    for (QMap<QString, QAction *>::ConstIterator it = d->actionByName.constBegin();
-            it != d->actionByName.constEnd(); ++it) {
-
-        QAction *action = it.value();
-        if (!action) {
+    Q_FOREACH (QAction *action, writeActions) {
+        if (!action || !d->actionEntries.contains(action)) {
             continue;
         }
 
-        QString actionName = it.key();
+        const QString actionName = d->actionEntries.value(action).name;
 
         // If the action name starts with unnamed- spit out a warning and ignore
         // it. That name will change at will and will break loading writing
@@ -686,7 +877,10 @@ void KActionCollection::writeSettings(KConfigGroup *config, bool writeAll, QActi
 
         // Write the shortcut
         if (isShortcutsConfigurable(action)) {
-            bool bConfigHasAction = !config->readEntry(actionName, QString()).isEmpty();
+            if (defaultStorage && !writeAll && d->shortcutsSaved(action)) {
+                continue;
+            }
+
             bool bSameAsDefault = (action->shortcuts() == defaultShortcuts(action));
             // If we're using a global config or this setting
             //  differs from the default, then we want to write.
@@ -707,15 +901,20 @@ void KActionCollection::writeSettings(KConfigGroup *config, bool writeAll, QActi
                 qCDebug(DEBUG_KXMLGUI) << "\twriting " << actionName << " = " << s;
                 config->writeEntry(actionName, s, flags);
 
-            } else if (bConfigHasAction) {
+            } else if (!config->readEntry(actionName, QString()).isEmpty()) {
                 // Otherwise, this key is the same as default but exists in
                 // config file. Remove it.
                 qCDebug(DEBUG_KXMLGUI) << "\tremoving " << actionName << " because == default";
                 config->deleteEntry(actionName, flags);
             }
+
+            if (defaultStorage) {
+                d->setShortcutsSaved(action);
+            }
         }
     }
 
+    // a single sync for all the changes, nothing to do if there were none
     config->sync();
 }
 
@@ -823,31 +1022,87 @@ QAction *KActionCollectionPrivate::unlistAction(QAction *action)
     //   during _k_actionDestroyed(). So don't do fancy stuff here that needs a
     //   real QAction!
 
-    // Get the index for the action
-    int index = actions.indexOf(action);
+    QHash<QAction *, ActionEntry>::iterator it = actionEntries.find(action);
 
     // Action not found.
-    if (index == -1) {
+    if (it == actionEntries.end()) {
         return nullptr;
     }
 
-    // An action collection can't have the same action twice.
-    Q_ASSERT(actions.indexOf(action, index + 1) == -1);
+    // Remove the action, under the name it was added with (the objectName
+    // might have been changed since)
+    if (actionByName.value(it->name) == action) {
+        actionByName.remove(it->name);
+    }
+    const QList<QPointer<KActionCategory> > categories = it->categories;
+    actionsBySequence.remove(it->sequence);
+    actionEntries.erase(it);
+    actionsListValid = false;
+
+    // Remove the action from its categories. Should be only one
+    for (int i = 0; i < categories.count(); ++i) {
+        if (KActionCategory *category = categories.at(i)) {
+            category->unlistAction(action);
+        }
+    }
+
+    return action;
+}
+
+void KActionCollectionPrivate::listAction(const QString &name, QAction *action)
+{
+    ActionEntry entry;
+    entry.name = name;
+    entry.sequence = nextSequence++;
+    actionByName.insert(name, action);
+    actionEntries.insert(action, entry);
+    actionsBySequence.insert(entry.sequence, action);
+    if (actionsListValid) {
+        actionsList.append(action);
+    }
+}
+
+bool KActionCollectionPrivate::shortcutsSaved(QAction *action) const
+{
+    QHash<QAction *, ActionEntry>::const_iterator it = actionEntries.constFind(action);
+    return it != actionEntries.constEnd() && it->saved && it->savedShortcuts == action->shortcuts()
+           && it->savedDefaultShortcuts == q->defaultShortcuts(action);
+}
 
-    // Get the actions name
-    const QString name = action->objectName();
+void KActionCollectionPrivate::setShortcutsSaved(QAction *action)
+{
+    QHash<QAction *, ActionEntry>::iterator it = actionEntries.find(action);
+    if (it != actionEntries.end()) {
+        it->savedShortcuts = action->shortcuts();
+        it->savedDefaultShortcuts = q->defaultShortcuts(action);
+        it->saved = true;
+    }
+}
 
-    // Remove the action
-    actionByName.remove(name);
-    actions.removeAt(index);
+void KActionCollectionPrivate::forgetSavedShortcuts()
+{
+    for (QHash<QAction *, ActionEntry>::iterator it = actionEntries.begin(); it != actionEntries.end(); ++it) {
+        it->saved = false;
+        it->savedShortcuts.clear();
+        it->savedDefaultShortcuts.clear();
+    }
+}
 
-    // Remove the action from the categories. Should be only one
-    QList<KActionCategory *> categories = q->findChildren<KActionCategory *>();
-    Q_FOREACH (KActionCategory *category, categories) {
-        category->unlistAction(action);
+const QList<QAction *> &KActionCollectionPrivate::orderedActions() const
+{
+    if (!actionsListValid) {
+        actionsList = actionsBySequence.values();
+        actionsListValid = true;
     }
+    return actionsList;
+}
 
-    return action;
+void KActionCollection::addActionToCategory(QAction *action, KActionCategory *category)
+{
+    QHash<QAction *, KActionCollectionPrivate::ActionEntry>::iterator it = d->actionEntries.find(action);
+    if (it != d->actionEntries.end() && !it->categories.contains(category)) {
+        it->categories.append(category);
+    }
 }
 
 QList< QWidget * > KActionCollection::associatedWidgets() const
@@ -36,6 +36,7 @@ class QAction;
 class KXMLGUIClient;
 class KConfigGroup;
 class QActionGroup;
+class KActionCategory;
 class QString;
 
 /**
@@ -181,6 +182,9 @@ public:
       * \note @p oneAction and @p writeDefaults have no meaning for the kxmlgui
       * configuration file.
       *
+      * If @p config is zero, only the shortcuts which changed since they were last
+      * read with readSettings() or written with this method are written.
+      *
       * \param config Config object to save to, or null (see above)
       * \param writeDefaults set to true to write settings which are already at defaults.
       * \param oneAction pass an action here if you just want to save the values for one action, eg.
@@ -210,6 +214,9 @@ public:
     /**
      * Get the action with the given \p name from the action collection.
      *
+     * The actions are kept in a hash of their names, so this takes about the same
+     * time however many actions there are.
+     *
      * @param name Name of the QAction
      * @return A pointer to the QAction in the collection which matches the parameters or
      * null if nothing matches.
@@ -270,6 +277,16 @@ Q_SIGNALS:
      */
     void inserted(QAction *action);
 
+    /**
+     * Indicates that @p actions were inserted into this action collection, after
+     * inserted() was emitted for each of them.
+     *
+     * Emitted once per addActions() call, and once per addAction() call with a
+     * single action.
+     * @since 5.50
+     */
+    void actionsInserted(const QList<QAction *> &actions);
+
     /**
      * Indicates that @p action was removed from this action collection.
      * @deprecated
@@ -341,7 +358,10 @@ public:
      * The ownership of the action objects is not transferred.
      * If the action is destroyed it will be removed automatically from the KActionCollection.
      *
-     * Uses addAction(const QString&, QAction*).
+     * Same as addAction(const QString&, QAction*) for each action, except that the
+     * associated widgets get all the actions at once, and that inserted() is only emitted
+     * once all the actions are in the collection, followed by a single actionsInserted().
+     * Prefer this when adding many actions, e.g. when loading a plugin.
      *
      * @param actions the list of the actions to add.
      *
@@ -356,6 +376,17 @@ public:
      */
     void removeAction(QAction *action);
 
+    /**
+     * Removes a list of actions from the collection and deletes them.
+     *
+     * Same as removeAction() for each action, but all the actions are removed from
+     * the collection before being deleted.
+     *
+     * @param actions The actions to remove.
+     * @since 5.50
+     */
+    void removeActions(const QList<QAction *> &actions);
+
     /**
      * Removes an action from the collection.
      *
@@ -581,6 +612,10 @@ private:
 
     KActionCollection(const KXMLGUIClient *parent);   // used by KXMLGUIClient
 
+    // Called by KActionCategory when it lists @p action
+    friend class KActionCategory;
+    void addActionToCategory(QAction *action, KActionCategory *category);
+
     friend class KActionCollectionPrivate;
     class KActionCollectionPrivate *const d;
 };
@@ -19,6 +19,8 @@
 */
 #include "kedittoolbar.h"
 #include "kedittoolbar_p.h"
+#include "kxmlguifileindex_p.h"
+#include "kxmlguishareddocuments_p.h"
 #include "debug.h"
 
 #include <QShowEvent>
@@ -682,8 +684,11 @@ void KEditToolBarPrivate::defaultClicked()
                 if (!QFile::remove(file)) {
                     qCWarning(DEBUG_KXMLGUI) << "Could not delete" << file;
                 }
+            KXmlGuiSharedDocuments::invalidate(client->componentName());
         }
 
+        KXmlGuiFileIndex::self()->invalidate();
+
         // Reload the xml files in all clients, now that the local files are gone
         oldWidget->rebuildKXMLGUIClients();
 
@@ -701,6 +706,8 @@ void KEditToolBarPrivate::defaultClicked()
             if (!QFile::remove(xml_file)) {
                 qCWarning(DEBUG_KXMLGUI) << "Could not delete " << xml_file;
             }
+        KXmlGuiFileIndex::self()->invalidate();
+        KXmlGuiSharedDocuments::invalidate(QCoreApplication::instance()->applicationName());
 
         m_widget = new KEditToolBarWidget(m_collection, q);
         q->setResourceFile(m_file, m_global);
@@ -868,6 +875,10 @@ void KEditToolBarWidgetPrivate::initFromFactory(KXMLGUIFactory *factory,
 
         XmlData data(type, client->localXMLFile(), client->actionCollection());
         QDomDocument domDoc = client->domDocument();
+        if (KXmlGuiSharedDocuments::isShared(domDoc)) {
+            // it's edited in place
+            domDoc = domDoc.cloneNode(true).toDocument();
+        }
         data.setDomDocument(domDoc);
         m_xmlFiles.append(data);
 
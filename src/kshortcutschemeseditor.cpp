@@ -135,6 +135,7 @@ void KShortcutSchemesEditor::newScheme()
 
     QTextStream out(&schemeFile);
     out << doc.toString(4);
+    KShortcutSchemesHelper::schemeFilesChanged();
 
     m_schemesList->addItem(newName);
     m_schemesList->setCurrentIndex(m_schemesList->findText(newName));
@@ -161,6 +162,7 @@ Note that this will not remove any system wide shortcut schemes.", currentScheme
         }
         QFile::remove(KShortcutSchemesHelper::writableShortcutSchemeFileName(client->componentName(), currentScheme()));
     }
+    KShortcutSchemesHelper::schemeFilesChanged();
 
     m_schemesList->removeItem(m_schemesList->findText(currentScheme()));
     updateDeleteButton();
@@ -31,6 +31,7 @@
 
 #include "kactioncollection.h"
 #include "kxmlguiclient.h"
+#include "kxmlguifileindex_p.h"
 #include "debug.h"
 
 bool KShortcutSchemesHelper::saveShortcutScheme(const QList<KActionCollection *> &collections,
@@ -104,6 +105,7 @@ bool KShortcutSchemesHelper::saveShortcutScheme(const QList<KActionCollection *>
             QTextStream out(&schemeFile);
             out << doc.toString(2);
         }
+        schemeFilesChanged();
     }
     return true;
 }
@@ -129,14 +131,18 @@ QString KShortcutSchemesHelper::writableApplicationShortcutSchemeFileName(const
 
 QString KShortcutSchemesHelper::shortcutSchemeFileName(const QString &componentName, const QString &schemeName)
 {
-    return QStandardPaths::locate(QStandardPaths::GenericDataLocation,
-                                  componentName + QStringLiteral("/shortcuts/") +
-                                  schemeName);
+    // every client looks its scheme up whenever it's added, use the index rather than QStandardPaths::locate
+    return KXmlGuiFileIndex::self()->locate(componentName + QStringLiteral("/shortcuts/") +
+                                            schemeName);
 }
 
 QString KShortcutSchemesHelper::applicationShortcutSchemeFileName(const QString &schemeName)
 {
-    return QStandardPaths::locate(QStandardPaths::GenericDataLocation,
-                                  QCoreApplication::applicationName() + QStringLiteral("/shortcuts/") +
-                                  schemeName);
+    return KXmlGuiFileIndex::self()->locate(QCoreApplication::applicationName() + QStringLiteral("/shortcuts/") +
+                                            schemeName);
+}
+
+void KShortcutSchemesHelper::schemeFilesChanged()
+{
+    KXmlGuiFileIndex::self()->invalidate();
 }
@@ -61,6 +61,11 @@ public:
      * @return the name of the scheme file for application itself, for reading.
     */
     static QString applicationShortcutSchemeFileName(const QString &schemeName);
+
+    /**
+     * Scheme files are located through KXmlGuiFileIndex, call this after creating or deleting one.
+    */
+    static void schemeFilesChanged();
 };
 
 #endif
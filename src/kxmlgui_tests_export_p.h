@@ -0,0 +1,35 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef KXMLGUI_TESTS_EXPORT_P_H
+#define KXMLGUI_TESTS_EXPORT_P_H
+
+#include <kxmlgui_export.h>
+
+/* Marks private classes which the unit tests use. They are only exported
+   when the tests are built (KXMLGUI_BUILD_TESTS, see CMakeLists.txt), so
+   that they don't become part of the ABI of the library. */
+#ifndef KXMLGUI_TESTS_EXPORT
+# if defined(KF5XmlGui_EXPORTS) && !defined(KXMLGUI_BUILD_TESTS)
+#  define KXMLGUI_TESTS_EXPORT
+# else
+#  define KXMLGUI_TESTS_EXPORT KXMLGUI_EXPORT
+# endif
+#endif
+
+#endif /* KXMLGUI_TESTS_EXPORT_P_H */
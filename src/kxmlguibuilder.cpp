@@ -21,6 +21,7 @@
 #include "kxmlguibuilder.h"
 
 #include "kxmlguiclient.h"
+#include "kxmlguifactory_p.h"
 #include "ktoolbar.h"
 #include "kmainwindow.h"
 #include "kxmlguiwindow.h"
@@ -128,7 +129,7 @@ QWidget *KXMLGUIBuilder::createContainer(QWidget *parent, int index, const QDomE
         return nullptr;
     }
 
-    const QString tagName = element.tagName().toLower();
+    const QString tagName = KXMLGUI::tagInfo(element.tagName()).name;
     if (tagName == d->tagMainWindow) {
         KMainWindow *mainwindow = qobject_cast<KMainWindow *>(d->m_widget);  // could be 0
         return mainwindow;
@@ -308,7 +309,7 @@ QAction *KXMLGUIBuilder::createCustomElement(QWidget *parent, int index, const Q
         before = parent->actions().at(index);
     }
 
-    const QString tagName = element.tagName().toLower();
+    const QString tagName = KXMLGUI::tagInfo(element.tagName()).name;
     if (tagName == d->tagSeparator) {
         if (QMenu *menu = qobject_cast<QMenu *>(parent)) {
             // QMenu already cares for leading/trailing/repeated separators
@@ -0,0 +1,309 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "kxmlguicache_p.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDomDocument>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QVector>
+
+// Bump this whenever the file format or the way documents are built changes
+static const quint32 s_cacheMagic = 0x4b584743; // "KXGC"
+static const quint32 s_cacheVersion = 1;
+
+enum CachedNodeType {
+    CachedEndOfChildren = 0,
+    CachedElement = 1,
+    CachedText = 2
+};
+
+static QString cacheDirectory(const QString &componentName)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+           QLatin1String("/kxmlgui5/") + componentName;
+}
+
+static void fileStamp(const QString &path, qint64 &size, qint64 &mtime)
+{
+    const QFileInfo info(path);
+    if (!info.exists()) {
+        size = -1;
+        mtime = 0;
+        return;
+    }
+    size = info.size();
+    const QDateTime lastModified = info.lastModified();
+    mtime = lastModified.isValid() ? lastModified.toMSecsSinceEpoch() : 0;
+}
+
+// Strings (tag names, attribute names and values) are written once; later
+// occurrences only refer to their index in the table.
+static void writeAtom(QDataStream &out, QHash<QString, quint32> &atoms, const QString &str)
+{
+    QHash<QString, quint32>::const_iterator it = atoms.constFind(str);
+    if (it != atoms.constEnd()) {
+        out << *it;
+        return;
+    }
+    const quint32 index = atoms.size();
+    atoms.insert(str, index);
+    out << index << str;
+}
+
+static bool readAtom(QDataStream &in, QVector<QString> &atoms, QString &str)
+{
+    quint32 index;
+    in >> index;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    if (index < quint32(atoms.size())) {
+        str = atoms.at(index);
+        return true;
+    }
+    if (index != quint32(atoms.size())) {
+        return false;
+    }
+    in >> str;
+    atoms.append(str);
+    return in.status() == QDataStream::Ok;
+}
+
+static void writeElement(QDataStream &out, QHash<QString, quint32> &atoms, const QDomElement &element)
+{
+    out << quint8(CachedElement);
+    writeAtom(out, atoms, element.tagName());
+
+    const QDomNamedNodeMap attributes = element.attributes();
+    const int count = attributes.count();
+    out << quint32(count);
+    for (int i = 0; i < count; ++i) {
+        const QDomAttr attr = attributes.item(i).toAttr();
+        writeAtom(out, atoms, attr.name());
+        writeAtom(out, atoms, attr.value());
+    }
+
+    for (QDomNode n = element.firstChild(); !n.isNull(); n = n.nextSibling()) {
+        if (n.isElement()) {
+            writeElement(out, atoms, n.toElement());
+        } else if (n.isText()) { // also true for CDATA sections
+            out << quint8(CachedText) << n.toText().data();
+        }
+    }
+    out << quint8(CachedEndOfChildren);
+}
+
+static bool readChildren(QDataStream &in, QVector<QString> &atoms, QDomDocument &doc, QDomNode parent)
+{
+    Q_FOREVER {
+        quint8 type;
+        in >> type;
+        if (in.status() != QDataStream::Ok) {
+            return false;
+        }
+        switch (type) {
+        case CachedEndOfChildren:
+            return true;
+        case CachedText: {
+            QString text;
+            in >> text;
+            parent.appendChild(doc.createTextNode(text));
+            break;
+        }
+        case CachedElement: {
+            QString tagName;
+            if (!readAtom(in, atoms, tagName)) {
+                return false;
+            }
+            QDomElement element = doc.createElement(tagName);
+            quint32 count;
+            in >> count;
+            for (quint32 i = 0; i < count; ++i) {
+                QString name;
+                QString value;
+                if (!readAtom(in, atoms, name) || !readAtom(in, atoms, value)) {
+                    return false;
+                }
+                element.setAttribute(name, value);
+            }
+            parent.appendChild(element);
+            if (!readChildren(in, atoms, doc, element)) {
+                return false;
+            }
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+}
+
+KXmlGuiCache::KXmlGuiCache(const QString &componentName, const QStringList &keyData)
+    : m_componentName(componentName)
+{
+    m_key = QByteArray::number(s_cacheVersion) + '\n' + componentName.toUtf8() + '\n' +
+            keyData.join(QLatin1Char('\n')).toUtf8();
+}
+
+QString KXmlGuiCache::cacheFileName() const
+{
+    const QByteArray hash = QCryptographicHash::hash(m_key, QCryptographicHash::Sha1).toHex();
+    return cacheDirectory(m_componentName) + QLatin1Char('/') + QString::fromLatin1(hash) + QLatin1String(".cache");
+}
+
+bool KXmlGuiCache::load(QDomDocument &doc) const
+{
+    if (!isEnabled() || m_componentName.isEmpty()) {
+        return false;
+    }
+
+    QFile file(cacheFileName());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic;
+    quint32 version;
+    in >> magic >> version;
+    if (magic != s_cacheMagic || version != s_cacheVersion) {
+        return false;
+    }
+
+    QByteArray key;
+    in >> key;
+    if (key != m_key) { // hash collision
+        return false;
+    }
+
+    quint32 sourceCount;
+    in >> sourceCount;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    for (quint32 i = 0; i < sourceCount; ++i) {
+        QString path;
+        qint64 size;
+        qint64 mtime;
+        in >> path >> size >> mtime;
+        if (in.status() != QDataStream::Ok) {
+            return false;
+        }
+        qint64 currentSize;
+        qint64 currentMtime;
+        fileStamp(path, currentSize, currentMtime);
+        if (size != currentSize || mtime != currentMtime) {
+            return false;
+        }
+    }
+
+    QByteArray data;
+    in >> data;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    return deserialize(data, doc);
+}
+
+void KXmlGuiCache::save(const QDomDocument &doc, const QStringList &sourceFiles) const
+{
+    if (!isEnabled() || m_componentName.isEmpty() || doc.documentElement().isNull()) {
+        return;
+    }
+
+    if (!QDir().mkpath(cacheDirectory(m_componentName))) {
+        return;
+    }
+
+    QSaveFile file(cacheFileName());
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << s_cacheMagic << s_cacheVersion << m_key;
+    out << quint32(sourceFiles.count());
+    Q_FOREACH (const QString &path, sourceFiles) {
+        qint64 size;
+        qint64 mtime;
+        fileStamp(path, size, mtime);
+        out << path << size << mtime;
+    }
+    out << serialize(doc);
+
+    if (out.status() != QDataStream::Ok) {
+        file.cancelWriting();
+    }
+    file.commit();
+}
+
+void KXmlGuiCache::invalidate(const QString &componentName)
+{
+    if (componentName.isEmpty()) {
+        return;
+    }
+    QDir dir(cacheDirectory(componentName));
+    if (dir.exists()) {
+        dir.removeRecursively();
+    }
+}
+
+bool KXmlGuiCache::isEnabled()
+{
+    return qEnvironmentVariableIntValue("KXMLGUI_DISABLE_CACHE") == 0;
+}
+
+QByteArray KXmlGuiCache::serialize(const QDomDocument &doc)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_6);
+
+    QHash<QString, quint32> atoms;
+    const QDomElement docElem = doc.documentElement();
+    if (!docElem.isNull()) {
+        writeElement(out, atoms, docElem);
+    }
+    out << quint8(CachedEndOfChildren);
+    return data;
+}
+
+bool KXmlGuiCache::deserialize(const QByteArray &data, QDomDocument &doc)
+{
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    QDomDocument result;
+    QVector<QString> atoms;
+    if (!readChildren(in, atoms, result, result) || result.documentElement().isNull()) {
+        return false;
+    }
+    doc = result;
+    return true;
+}
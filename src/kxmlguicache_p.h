@@ -0,0 +1,79 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef KXMLGUICACHE_P_H
+#define KXMLGUICACHE_P_H
+
+#include <QByteArray>
+#include <QStringList>
+
+class QDomDocument;
+
+/**
+ * @internal
+ * On-disk cache of merged XMLGUI documents, used by KXMLGUIClient::loadStandardsAndXmlFile.
+ *
+ * Building the GUI of a main window means locating, reading and parsing ui_standards.rc
+ * and the application's .rc files, and merging them together. The result only depends
+ * on those files, the translation domain and the (authorized) actions of the client,
+ * so it is stored in a compact binary form in the cache directory, together with the
+ * size and modification time of every file it was built from.
+ *
+ * Set KXMLGUI_DISABLE_CACHE=1 in the environment to bypass the cache.
+ */
+class KXmlGuiCache
+{
+public:
+    /**
+     * @param componentName the component the document belongs to
+     * @param keyData everything (besides the source files) the document depends on,
+     * e.g. the requested file names, the translation domain and the action names
+     */
+    KXmlGuiCache(const QString &componentName, const QStringList &keyData);
+
+    /**
+     * Loads the cached document into @p doc.
+     * @return false if there is no cached document, or if one of its source files changed
+     */
+    bool load(QDomDocument &doc) const;
+
+    /**
+     * Stores @p doc, which was built from @p sourceFiles.
+     * Files which don't exist (yet) are remembered as such, so that creating them
+     * invalidates the cached document as well.
+     */
+    void save(const QDomDocument &doc, const QStringList &sourceFiles) const;
+
+    QString cacheFileName() const;
+
+    /**
+     * Removes all cached documents of @p componentName, e.g. after saving a local xml file.
+     */
+    static void invalidate(const QString &componentName);
+
+    static bool isEnabled();
+
+    static QByteArray serialize(const QDomDocument &doc);   // used by the unit test
+    static bool deserialize(const QByteArray &data, QDomDocument &doc);   // used by the unit test
+
+private:
+    QString m_componentName;
+    QByteArray m_key;
+};
+
+#endif /* KXMLGUICACHE_P_H */
@@ -20,6 +20,12 @@
 #include "kxmlguiclient.h"
 
 #include "kxmlguiversionhandler_p.h"
+#include "kxmlguifactory_p.h"
+#include "kxmlguicache_p.h"
+#include "kxmlguiloader_p.h"
+#include "kxmlguipreloader_p.h"
+#include "kxmlguiprofiler_p.h"
+#include "kxmlguishareddocuments_p.h"
 #include "kxmlguifactory.h"
 #include "kxmlguibuilder.h"
 #include "kactioncollection.h"
@@ -29,6 +35,8 @@
 #include <QDir>
 #include <QFile>
 #include <QDomDocument>
+#include <QHash>
+#include <QPair>
 #include <QTextStream>
 #include <QRegExp>
 #include <QPointer>
@@ -40,6 +48,31 @@
 
 #include <assert.h>
 
+namespace {
+struct DocumentRevisions {
+    DocumentRevisions() : last(0) {}
+    QHash<const KXMLGUIClient *, quint64> revisions;
+    quint64 last;
+};
+}
+Q_GLOBAL_STATIC(DocumentRevisions, s_documentRevisions)
+
+quint64 KXMLGUI::documentRevision(const KXMLGUIClient *client)
+{
+    return s_documentRevisions()->revisions.value(client);
+}
+
+static void documentChanged(const KXMLGUIClient *client)
+{
+    DocumentRevisions *revisions = s_documentRevisions();
+    revisions->revisions.insert(client, ++revisions->last);
+}
+
+static QStringList defaultTextTagNames()
+{
+    return QStringList() << QStringLiteral("text") << QStringLiteral("Text") << QStringLiteral("title");
+}
+
 class KXMLGUIClientPrivate
 {
 public:
@@ -47,11 +80,9 @@ public:
         : m_componentName(QCoreApplication::applicationName()),
           m_actionCollection(nullptr),
           m_parent(nullptr),
-          m_builder(nullptr)
+          m_builder(nullptr),
+          m_textTagNames(defaultTextTagNames())
     {
-        m_textTagNames.append(QStringLiteral("text"));
-        m_textTagNames.append(QStringLiteral("Text"));
-        m_textTagNames.append(QStringLiteral("title"));
     }
     ~KXMLGUIClientPrivate()
     {
@@ -62,12 +93,14 @@ public:
     bool isEmptyContainer(const QDomElement &base,
                           KActionCollection *actionCollection) const;
 
-    QDomElement findMatchingElement(const QDomElement &base,
-                                    const QDomElement &additive);
+    void shareDocument(const QString &key);
+    void releaseSharedDocument();
+    void detachDocument();
 
     QString m_componentName;
 
     QDomDocument m_doc;
+    QString m_sharedDocumentKey; // if m_doc is shared with other clients
     KActionCollection *m_actionCollection;
     QDomDocument m_buildDocument;
     QPointer<KXMLGUIFactory> m_factory;
@@ -77,6 +110,7 @@ public:
     KXMLGUIBuilder *m_builder;
     QString m_xmlFile;
     QString m_localXMLFile;
+    QStringList m_xmlFileCandidates; // files located by the last setXMLFile call
     QStringList m_textTagNames;
 
     // Actions to enable/disable on a state change
@@ -113,6 +147,10 @@ KXMLGUIClient::~KXMLGUIClient()
         client->d->m_parent = nullptr;
     }
 
+    d->releaseSharedDocument();
+    if (!s_documentRevisions.isDestroyed()) {
+        s_documentRevisions()->revisions.remove(this);
+    }
     delete d->m_actionCollection;
     delete d;
 }
@@ -210,9 +248,101 @@ QString KXMLGUIClient::standardsXmlFileLocation()
     return file;
 }
 
+// Parses an xmlgui document, propagating the translation domain of the document
+// to its text elements (see KXmlGuiLoader).
+template<typename Data>
+static QDomDocument loadDocument(const Data &data, const QStringList &textTagNames)
+{
+    // QDomDocument raises a parse error on empty document, but we accept no app-specific document,
+    // in which case you only get ui_standards.rc layout.
+    if (data.isEmpty()) {
+        return QDomDocument();
+    }
+
+    KXmlGuiProfiler::Phase phase("parseXML");
+    QDomDocument doc;
+    KXmlGuiLoader::Error error;
+    if (!KXmlGuiLoader::load(data, doc, QString::fromUtf8(KLocalizedString::applicationDomain()), textTagNames, &error)) {
+        qCritical() << "Error parsing XML document:" << error.message << "at line" << error.line << "column" << error.column;
+#ifndef NDEBUG
+        abort();
+#endif
+        return QDomDocument(); // otherwise empty menus from ui_standards.rc stay around
+    }
+    return doc;
+}
+
 void KXMLGUIClient::loadStandardsXmlFile()
 {
-    setXML(KXMLGUIFactory::readConfigFile(standardsXmlFileLocation()));
+    setDOMDocument(loadDocument(KXMLGUIFactory::readConfigFileData(standardsXmlFileLocation()), d->m_textTagNames));
+}
+
+void KXMLGUIClient::loadStandardsAndXmlFile(const QString &file)
+{
+    const QString standardsFile = standardsXmlFileLocation();
+    if (!KXmlGuiCache::isEnabled() && !KXmlGuiSharedDocuments::isEnabled()) {
+        setDOMDocument(loadDocument(KXMLGUIFactory::readConfigFileData(standardsFile), d->m_textTagNames));
+        setXMLFile(file, true);
+        return;
+    }
+
+    // The merged document only keeps the actions which exist (and are authorized),
+    // so they are part of the cache key, as well as the translation domain which
+    // ends up in the text elements.
+    QStringList keyData;
+    keyData << standardsFile << file << d->m_localXMLFile << KLocalizedString::applicationDomain();
+    QStringList actionNames;
+    Q_FOREACH (QAction *action, actionCollection()->actions()) {
+        const QString name = action->objectName();
+        if (!name.isEmpty() && KAuthorized::authorizeAction(name)) {
+            actionNames.append(name);
+        }
+    }
+    actionNames.sort();
+    keyData += actionNames;
+
+    // another client built the same document already
+    QString sharedKey;
+    if (KXmlGuiSharedDocuments::isEnabled()) {
+        sharedKey = KXmlGuiSharedDocuments::key(componentName(), keyData);
+        const QDomDocument shared = KXmlGuiSharedDocuments::acquire(sharedKey);
+        if (!shared.isNull()) {
+            setXMLFile(file, true, false); // only remember the file name
+            setDOMDocument(shared);
+            if (d->m_doc == shared) {
+                d->m_sharedDocumentKey = sharedKey;
+            } else {
+                KXmlGuiSharedDocuments::release(sharedKey, shared);
+            }
+            return;
+        }
+    }
+
+    KXmlGuiCache cache(componentName(), keyData);
+    QDomDocument doc;
+    if (cache.load(doc)) {
+        setXMLFile(file, true, false); // only remember the file name
+        setDOMDocument(doc);
+        d->shareDocument(sharedKey);
+        return;
+    }
+
+    setDOMDocument(loadDocument(KXMLGUIFactory::readConfigFileData(standardsFile), d->m_textTagNames));
+    d->m_xmlFileCandidates.clear();
+    setXMLFile(file, true);
+
+    if (d->m_xmlFileCandidates.isEmpty()) {
+        return; // nothing found, don't remember that
+    }
+    QStringList sourceFiles = d->m_xmlFileCandidates;
+    sourceFiles.prepend(standardsFile);
+    // creating the local file (e.g. by editing toolbars) must invalidate the cache
+    const QString localFile = localXMLFile();
+    if (!localFile.isEmpty() && !sourceFiles.contains(localFile)) {
+        sourceFiles.append(localFile);
+    }
+    cache.save(d->m_doc, sourceFiles);
+    d->shareDocument(sharedKey);
 }
 
 void KXMLGUIClient::setXMLFile(const QString &_file, bool merge, bool setXMLDoc)
@@ -226,38 +356,47 @@ void KXMLGUIClient::setXMLFile(const QString &_file, bool merge, bool setXMLDoc)
         return;
     }
 
-    QString file = _file;
-    QStringList allFiles;
-    if (!QDir::isRelativePath(file)) {
-        allFiles.append(file);
-    } else {
-        const QString filter = componentName() + QLatin1Char('/') + _file;
-
-        // files on filesystem
-        allFiles << QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QStringLiteral("kxmlgui5/") + filter); // KF >= 5.1
+    KXmlGuiProfiler::Phase phase("setXMLFile", this);
 
-        // KF >= 5.4 (resource file)
-        const QString qrcFile(QStringLiteral(":/kxmlgui5/") + filter);
-        if (QFile::exists(qrcFile)) {
-            allFiles << qrcFile;
+    QString file = _file;
+    const QString domain = QString::fromUtf8(KLocalizedString::applicationDomain());
+
+    // the document can be shared if it's used as is, rather than merged into the current one
+    QString sharedKey;
+    if (KXmlGuiSharedDocuments::isEnabled() && (!merge || d->m_doc.isNull())) {
+        QStringList keyData;
+        keyData << file << d->m_localXMLFile << domain;
+        keyData += d->m_textTagNames;
+        sharedKey = KXmlGuiSharedDocuments::key(componentName(), keyData);
+        QStringList sharedFiles;
+        const QDomDocument shared = KXmlGuiSharedDocuments::acquire(sharedKey, &sharedFiles);
+        if (!shared.isNull()) {
+            d->m_xmlFileCandidates = sharedFiles;
+            setDOMDocument(shared, merge);
+            if (d->m_doc == shared) {
+                d->m_sharedDocumentKey = sharedKey;
+            } else {
+                KXmlGuiSharedDocuments::release(sharedKey, shared);
+            }
+            return;
         }
+    }
 
-        // then compat locations
-        const QStringList compatFiles =
-                   QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, filter) + // kdelibs4, KF 5.0
-                   QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, _file); // kdelibs4, KF 5.0, caller passes component name
-
-        if (allFiles.isEmpty() && !compatFiles.isEmpty()) {
-            qCWarning(DEBUG_KXMLGUI) << "KXMLGUI file found at deprecated location" << compatFiles << "-- please use ${KXMLGUI_INSTALL_DIR} to install this file instead.";
+    // preloadXMLFile() did the work already
+    if (d->m_localXMLFile.isEmpty()) {
+        QDomDocument preloaded;
+        QStringList preloadedFiles;
+        if (KXmlGuiPreloader::self()->take(file, componentName(), domain,
+                                           d->m_textTagNames, preloaded, preloadedFiles)) {
+            d->m_xmlFileCandidates = preloadedFiles;
+            setDOMDocument(preloaded, merge);
+            d->shareDocument(sharedKey);
+            return;
         }
-        allFiles += compatFiles;
-    }
-    if (allFiles.isEmpty() && !_file.isEmpty()) {
-        // if a non-empty file gets passed and we can't find it,
-        // inform the developer using some debug output
-        qCWarning(DEBUG_KXMLGUI) << "cannot find .rc file" << _file << "for component" << componentName();
     }
 
+    QStringList allFiles = KXmlGuiPreloader::locateXmlFiles(file, componentName());
+
     // make sure to merge the settings from any file specified by setLocalXMLFile()
     if (!d->m_localXMLFile.isEmpty() && !file.endsWith(QStringLiteral("ui_standards.rc"))) {
         const bool exists = QDir::isRelativePath(d->m_localXMLFile) || QFile::exists(d->m_localXMLFile);
@@ -266,13 +405,38 @@ void KXMLGUIClient::setXMLFile(const QString &_file, bool merge, bool setXMLDoc)
         }
     }
 
-    QString doc;
+    d->m_xmlFileCandidates = allFiles;
+
+    QByteArray doc;
     if (!allFiles.isEmpty()) {
-        file = findMostRecentXMLFile(allFiles, doc);
+        QDomDocument merged;
+        {
+            // picks the most recent version and parses it
+            KXmlGuiProfiler::Phase phase("parseXML");
+            KXmlGuiVersionHandler versionHandler(allFiles);
+            merged = versionHandler.mergedDocument();
+            if (merged.isNull()) {
+                doc = versionHandler.finalDocumentData();
+            } else {
+                KXmlGuiLoader::propagateTranslationDomain(merged, domain, d->m_textTagNames);
+            }
+        }
+        if (!merged.isNull()) {
+            setDOMDocument(merged, merge);
+            d->shareDocument(sharedKey);
+            return;
+        }
     }
 
-    // Always call setXML, even on error, so that we don't keep all ui_standards.rc menus.
-    setXML(doc, merge);
+    // Always set the document, even on error, so that we don't keep all ui_standards.rc menus.
+    setDOMDocument(loadDocument(doc, d->m_textTagNames), merge);
+    d->shareDocument(sharedKey);
+}
+
+void KXMLGUIClient::preloadXMLFile(const QString &file, const QString &componentName)
+{
+    KXmlGuiPreloader::self()->preload(file, componentName.isEmpty() ? QCoreApplication::applicationName() : componentName,
+                                      QString::fromUtf8(KLocalizedString::applicationDomain()), defaultTextTagNames());
 }
 
 void KXMLGUIClient::setLocalXMLFile(const QString &file)
@@ -290,67 +454,30 @@ void KXMLGUIClient::replaceXMLFile(const QString &xmlfile, const QString &localx
     setXMLFile(xmlfile, merge);
 }
 
-// The top document element may have translation domain attribute set,
-// or the translation domain may be implicitly the application domain.
-// This domain must be used to fetch translations for all text elements
-// in the document that do not have their own domain attribute.
-// In order to preserve this semantics through document mergings,
-// the top or application domain must be propagated to all text elements
-// lacking their own domain attribute.
-static void propagateTranslationDomain(QDomDocument &doc, const QStringList tagNames)
-{
-    const QLatin1String attrDomain("translationDomain");
-    QDomElement base = doc.documentElement();
-    QString domain = base.attribute(attrDomain);
-    if (domain.isEmpty()) {
-        domain = QString::fromUtf8(KLocalizedString::applicationDomain());
-        if (domain.isEmpty()) {
-            return;
-        }
-    }
-    foreach (const QString &tagName, tagNames) {
-        QDomNodeList textNodes = base.elementsByTagName(tagName);
-        for (int i = 0; i < textNodes.length(); ++i) {
-            QDomElement e = textNodes.item(i).toElement();
-            QString localDomain = e.attribute(attrDomain);
-            if (localDomain.isEmpty()) {
-                 e.setAttribute(attrDomain, domain);
-            }
-        }
-    }
-}
-
 void KXMLGUIClient::setXML(const QString &document, bool merge)
 {
-    QDomDocument doc;
-    QString errorMsg;
-    int errorLine = 0, errorColumn = 0;
-    // QDomDocument raises a parse error on empty document, but we accept no app-specific document,
-    // in which case you only get ui_standards.rc layout.
-    bool result = document.isEmpty() || doc.setContent(document, &errorMsg, &errorLine, &errorColumn);
-    if (result) {
-        propagateTranslationDomain(doc, d->m_textTagNames);
-        setDOMDocument(doc, merge);
-    } else {
-#ifdef NDEBUG
-        qCritical() << "Error parsing XML document:" << errorMsg << "at line" << errorLine << "column" << errorColumn;
-        setDOMDocument(QDomDocument(), merge); // otherwise empty menus from ui_standards.rc stay around
-#else
-        qCritical() << "Error parsing XML document:" << errorMsg << "at line" << errorLine << "column" << errorColumn;
-        abort();
-#endif
-    }
+    setDOMDocument(loadDocument(document, d->m_textTagNames), merge);
 }
 
 void KXMLGUIClient::setDOMDocument(const QDomDocument &document, bool merge)
 {
     if (merge && !d->m_doc.isNull()) {
+        // merging modifies both documents
+        d->detachDocument();
+        QDomDocument additive = document;
+        if (KXmlGuiSharedDocuments::isShared(additive)) {
+            additive = additive.cloneNode(true).toDocument();
+        }
+
         QDomElement base = d->m_doc.documentElement();
 
-        QDomElement e = document.documentElement();
+        QDomElement e = additive.documentElement();
 
         // merge our original (global) xml with our new one
-        d->mergeXML(base, e, actionCollection());
+        {
+            KXmlGuiProfiler::Phase phase("mergeXML", this);
+            d->mergeXML(base, e, actionCollection());
+        }
 
         // reassign our pointer as mergeXML might have done something
         // strange to it
@@ -360,9 +487,10 @@ void KXMLGUIClient::setDOMDocument(const QDomDocument &document, bool merge)
 
         // we want some sort of failsafe.. just in case
         if (base.isNull()) {
-            d->m_doc = document;
+            d->m_doc = additive;
         }
     } else {
+        d->releaseSharedDocument();
         d->m_doc = document;
     }
 
@@ -379,6 +507,80 @@ static inline bool equalstr(const QString &a, const QLatin1String &b)
     return a.compare(b, Qt::CaseInsensitive) == 0;
 }
 
+namespace {
+// The child elements of a container, by tag (case insensitive) and name, to find the
+// element matching one of the other document quickly (see mergeXML).
+// Elements which were moved to another container meanwhile are ignored.
+class MatchingElementIndex
+{
+public:
+    explicit MatchingElementIndex(const QDomElement &parent)
+        : m_parent(parent)
+    {
+        for (QDomElement e = parent.firstChildElement(); !e.isNull(); e = e.nextSiblingElement()) {
+            insert(e);
+        }
+    }
+
+    void insert(const QDomElement &element)
+    {
+        const KXMLGUI::TagInfo tag = KXMLGUI::tagInfo(element.tagName());
+        // skip all action and merge tags as we will never use them
+        if (tag.tag == KXMLGUI::ActionTag || tag.name == QLatin1String("mergelocal")) {
+            return;
+        }
+        m_entries[Key(tag.name, element.attribute(QStringLiteral("name")))].append(Entry(element));
+    }
+
+    // Returns the first child matching @p element, or a null element
+    QDomElement find(const QDomElement &element)
+    {
+        Entry *entry = findEntry(element, false);
+        return entry ? entry->element : QDomElement();
+    }
+
+    void setVisited(const QDomElement &element)
+    {
+        if (Entry *entry = findEntry(element, true)) {
+            entry->visited = true;
+        }
+    }
+
+    bool isVisited(const QDomElement &element)
+    {
+        const Entry *entry = findEntry(element, true);
+        return entry && entry->visited;
+    }
+
+private:
+    typedef QPair<QString, QString> Key;
+    struct Entry {
+        explicit Entry(const QDomElement &e) : element(e), visited(false) {}
+        QDomElement element;
+        bool visited;
+    };
+
+    // @p identical: look for @p element itself rather than for a matching child
+    Entry *findEntry(const QDomElement &element, bool identical)
+    {
+        const QHash<Key, QList<Entry> >::iterator it =
+            m_entries.find(Key(KXMLGUI::tagInfo(element.tagName()).name, element.attribute(QStringLiteral("name"))));
+        if (it == m_entries.end()) {
+            return nullptr;
+        }
+        for (QList<Entry>::iterator entry = it->begin(); entry != it->end(); ++entry) {
+            if (identical ? entry->element == element : entry->element.parentNode() == m_parent) {
+                return &*entry;
+            }
+        }
+        return nullptr;
+    }
+
+    QDomElement m_parent;
+    QHash<Key, QList<Entry> > m_entries;
+};
+}
+
 bool KXMLGUIClientPrivate::mergeXML(QDomElement &base, QDomElement &additive, KActionCollection *actionCollection)
 {
     const QLatin1String tagAction("Action");
@@ -389,7 +591,6 @@ bool KXMLGUIClientPrivate::mergeXML(QDomElement &base, QDomElement &additive, KA
     const QLatin1String attrAppend("append");
     const QString       attrName(QStringLiteral("name"));
     const QString       attrWeakSeparator(QStringLiteral("weakSeparator"));
-    const QString       attrAlreadyVisited(QStringLiteral("alreadyVisited"));
     const QString       attrNoMerge(QStringLiteral("noMerge"));
     const QLatin1String attrOne("1");
 
@@ -413,6 +614,9 @@ bool KXMLGUIClientPrivate::mergeXML(QDomElement &base, QDomElement &additive, KA
             }
         }
 
+        MatchingElementIndex baseIndex(base);
+        MatchingElementIndex additiveIndex(additive);
+
         // iterate over all elements in the container (of the global DOM tree)
         QDomNode n = base.firstChild();
         while (!n.isNull()) {
@@ -470,7 +674,7 @@ bool KXMLGUIClientPrivate::mergeXML(QDomElement &base, QDomElement &additive, KA
                         continue;
                     }
 
-                    if (newChild.attribute(attrAlreadyVisited) == attrOne) {
+                    if (additiveIndex.isVisited(newChild)) {
                         continue;
                     }
 
@@ -482,9 +686,10 @@ bool KXMLGUIClientPrivate::mergeXML(QDomElement &base, QDomElement &additive, KA
                         // first, see if this new element matches a standard one in
                         // the global file.  if it does, then we skip it as it will
                         // be merged in, later
-                        QDomElement matchingElement = findMatchingElement(newChild, base);
+                        QDomElement matchingElement = baseIndex.find(newChild);
                         if (matchingElement.isNull() || equalstr(newChild.tagName(), tagSeparator)) {
                             base.insertBefore(newChild, e);
+                            baseIndex.insert(newChild);
                         }
                     }
                 }
@@ -504,13 +709,16 @@ bool KXMLGUIClientPrivate::mergeXML(QDomElement &base, QDomElement &additive, KA
             // recursively and delete the just proceeded container item in
             // case it is empty (if the recursive call returns true)
             else {
-                QDomElement matchingElement = findMatchingElement(e, additive);
+                QDomElement matchingElement = additiveIndex.find(e);
                 if (!matchingElement.isNull()) {
-                    matchingElement.setAttribute(attrAlreadyVisited, uint(1));
+                    additiveIndex.setVisited(matchingElement);
 
                     if (mergeXML(e, matchingElement, actionCollection)) {
                         base.removeChild(e);
                         additive.removeChild(matchingElement); // make sure we don't append it below
+                        if (matchingElement.parentNode() == base) { // noMerge replaced e
+                            baseIndex.insert(matchingElement);
+                        }
                         continue;
                     }
 
@@ -540,10 +748,11 @@ bool KXMLGUIClientPrivate::mergeXML(QDomElement &base, QDomElement &additive, KA
                 continue;
             }
 
-            QDomElement matchingElement = findMatchingElement(e, base);
+            QDomElement matchingElement = baseIndex.find(e);
 
             if (matchingElement.isNull()) {
                 base.appendChild(e);
+                baseIndex.insert(e);
             }
         }
 
@@ -612,37 +821,85 @@ bool KXMLGUIClientPrivate::isEmptyContainer(const QDomElement &base, KActionColl
     return true; // I'm empty, please delete me.
 }
 
-QDomElement KXMLGUIClientPrivate::findMatchingElement(const QDomElement &base, const QDomElement &additive)
+/*
+ * Registers the current document as @p key, for other clients loading the same files
+ * (see KXMLGUIClient::setDocumentSharingEnabled). Does nothing if @p key is empty.
+ */
+void KXMLGUIClientPrivate::shareDocument(const QString &key)
 {
-    QDomNode n = additive.firstChild();
-    while (!n.isNull()) {
-        QDomElement e = n.toElement();
-        n = n.nextSibling(); // Advance now so that we can safely delete e -- TODO we don't, so simplify this
-        if (e.isNull()) {
-            continue;
-        }
+    if (!key.isEmpty() && !m_doc.isNull() && m_sharedDocumentKey.isEmpty()) {
+        KXmlGuiSharedDocuments::insert(key, m_doc, m_xmlFileCandidates);
+        m_sharedDocumentKey = key;
+    }
+}
 
-        const QString tag = e.tagName();
-        // skip all action and merge tags as we will never use them
-        if (equalstr(tag, QLatin1String("Action"))
-                || equalstr(tag, QLatin1String("MergeLocal"))) {
-            continue;
-        }
+void KXMLGUIClientPrivate::releaseSharedDocument()
+{
+    if (!m_sharedDocumentKey.isEmpty()) {
+        KXmlGuiSharedDocuments::release(m_sharedDocumentKey, m_doc);
+        m_sharedDocumentKey.clear();
+    }
+}
+
+// Makes sure m_doc isn't shared, before modifying it
+void KXMLGUIClientPrivate::detachDocument()
+{
+    if (!m_sharedDocumentKey.isEmpty()) {
+        m_doc = KXmlGuiSharedDocuments::detach(m_sharedDocumentKey, m_doc);
+        m_sharedDocumentKey.clear();
+    }
+}
 
-        // now see if our tags are equivalent
-        if (equalstr(tag, base.tagName()) &&
-                e.attribute(QStringLiteral("name")) == base.attribute(QStringLiteral("name"))) {
-            return e;
+// Rough estimate of the memory used by @p node and its children: the node itself
+// (private node object and the shared pointers of its handles), and its strings
+static qint64 estimatedNodeMemoryUsage(const QDomNode &node)
+{
+    const qint64 nodeSize = 12 * sizeof(void *);
+    const qint64 stringSize = 4 * sizeof(void *); // QArrayData header and alignment
+
+    qint64 size = nodeSize + stringSize + node.nodeName().size() * sizeof(QChar);
+    if (node.isElement()) {
+        const QDomNamedNodeMap attributes = node.attributes();
+        const int count = attributes.count();
+        size += nodeSize; // the attribute map
+        for (int i = 0; i < count; ++i) {
+            size += estimatedNodeMemoryUsage(attributes.item(i));
         }
+    } else if (node.isCharacterData() || node.isAttr()) {
+        size += stringSize + node.nodeValue().size() * sizeof(QChar);
+    }
+    for (QDomNode child = node.firstChild(); !child.isNull(); child = child.nextSibling()) {
+        size += estimatedNodeMemoryUsage(child);
+    }
+    return size;
+}
+
+qint64 KXMLGUIClient::estimatedDomMemoryUsage() const
+{
+    qint64 size = 0;
+    if (!d->m_doc.isNull()) {
+        size += estimatedNodeMemoryUsage(d->m_doc);
+    }
+    if (!d->m_buildDocument.isNull()) {
+        size += estimatedNodeMemoryUsage(d->m_buildDocument);
     }
+    return size;
+}
 
-    // nope, return a (now) null element
-    return QDomElement();
+void KXMLGUIClient::setDocumentSharingEnabled(bool enable)
+{
+    KXmlGuiSharedDocuments::setEnabled(enable);
+}
+
+bool KXMLGUIClient::isDocumentSharingEnabled()
+{
+    return KXmlGuiSharedDocuments::isEnabled();
 }
 
 void KXMLGUIClient::setXMLGUIBuildDocument(const QDomDocument &doc)
 {
     d->m_buildDocument = doc;
+    documentChanged(this);
 }
 
 QDomDocument KXMLGUIClient::xmlguiBuildDocument() const
@@ -722,6 +979,15 @@ void KXMLGUIClient::unplugActionList(const QString &name)
     d->m_factory->unplugActionList(this, name);
 }
 
+void KXMLGUIClient::replaceActionList(const QString &name, const QList<QAction *> &actionList)
+{
+    if (!d->m_factory) {
+        return;
+    }
+
+    d->m_factory->replaceActionList(this, name, actionList);
+}
+
 QString KXMLGUIClient::findMostRecentXMLFile(const QStringList &files, QString &doc)
 {
     KXmlGuiVersionHandler versionHandler(files);
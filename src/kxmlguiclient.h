@@ -129,6 +129,32 @@ public:
 
     virtual QString localXMLFile() const;
 
+    /**
+     * Returns an estimate of the memory used by the documents of this client,
+     * i.e. domDocument() and the document the factory keeps the state of the
+     * containers in, in bytes. Documents shared with other clients
+     * (see setDocumentSharingEnabled()) are counted in full.
+     * @since 5.50
+     */
+    qint64 estimatedDomMemoryUsage() const;
+
+    /**
+     * Lets the clients which load the same xml files share one document, instead
+     * of keeping one copy each, e.g. the main windows of an application with many
+     * windows. The document of a client gets copied once another document is
+     * merged into it; besides that, it must not be modified through domDocument().
+     *
+     * Disabled by default. Only affects the documents loaded afterwards.
+     * @since 5.50
+     */
+    static void setDocumentSharingEnabled(bool enable);
+
+    /**
+     * @return whether clients share their documents, see setDocumentSharingEnabled()
+     * @since 5.50
+     */
+    static bool isDocumentSharingEnabled();
+
     /**
      * @internal
      */
@@ -256,6 +282,20 @@ public:
      */
     void unplugActionList(const QString &name);
 
+    /**
+     * Replaces the actions of the action list \p name with \p actionList.
+     *
+     * This has the same result as calling unplugActionList() and then
+     * plugActionList(), but only the actions which were added, removed or
+     * moved are inserted into and removed from the containers. Use it for
+     * lists which are refreshed often, e.g. in a slot connected to
+     * QMenu::aboutToShow(), where most actions usually stay the same.
+     *
+     * \see plugActionList()
+     * \since 5.50
+     */
+    void replaceActionList(const QString &name, const QList<QAction *> &actionList);
+
     static QString findMostRecentXMLFile(const QStringList &files, QString &doc);
 
     void addStateActionEnabled(const QString &state, const QString &action);
@@ -342,6 +382,25 @@ protected:
      **/
     virtual void setXMLFile(const QString &file, bool merge = false, bool setXMLDoc = true);
 
+    /**
+     * Starts locating and parsing the xml file @p file of the component @p componentName
+     * in a background thread, so that a later setXMLFile(@p file) call from a client of that
+     * component doesn't have to do it anymore. If the file is still being loaded by then,
+     * setXMLFile() waits for it.
+     *
+     * This is meant for applications which load many plugins at once: the files of all
+     * plugins can be preloaded in parallel before creating the plugins.
+     *
+     * A preloaded document is only used once, and only if the client has no local xml file
+     * (see setLocalXMLFile()).
+     *
+     * @param file the file name, as passed to setXMLFile()
+     * @param componentName the component name of the client which will use the file,
+     * the application name if empty
+     * @since 5.50
+     */
+    static void preloadXMLFile(const QString &file, const QString &componentName = QString());
+
     /**
      * Return the full path to the ui_standards.rc, might return a resource path.
      * @return full path to ui_standards.rc, always non-empty.
@@ -355,6 +414,18 @@ protected:
      */
     void loadStandardsXmlFile();
 
+    /**
+     * Load the ui_standards.rc file and merge @p file into it, like
+     * loadStandardsXmlFile() followed by setXMLFile(file, true).
+     *
+     * The merged document is cached on disk, so that it doesn't need to be
+     * located, parsed and merged again as long as none of the files it was
+     * built from change. Since the result depends on the actions of the client,
+     * call this after creating all actions.
+     * @since 5.50
+     */
+    void loadStandardsAndXmlFile(const QString &file);
+
     /**
      * Set the full path to the "local" xml file, the one used for saving
      * toolbar and shortcut changes. You normally don't need to call this,
@@ -23,6 +23,12 @@
 
 #include "kxmlguifactory_p.h"
 #include "kshortcutschemeshelper_p.h"
+#include "kxmlguicache_p.h"
+#include "kxmlguifileindex_p.h"
+#include "kxmlguipreloader_p.h"
+#include "kxmlguiprofiler_p.h"
+#include "kxmlguishareddocuments_p.h"
+#include "kxmlguiversionhandler_p.h"
 #include "kxmlguiclient.h"
 #include "kxmlguibuilder.h"
 #include "kshortcutsdialog.h"
@@ -34,9 +40,13 @@
 #include <QDomDocument>
 #include <QFile>
 #include <QCoreApplication>
+#include <QPointer>
 #include <QTextStream>
 #include <QWidget>
 #include <QDate>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QIcon>
 #include <QVariant>
 #include <QTextCodec>
 #include <QStandardPaths>
@@ -51,12 +61,54 @@ Q_DECLARE_METATYPE(QList<QKeySequence>)
 
 using namespace KXMLGUI;
 
-class KXMLGUIFactoryPrivate : public BuildState
+/*
+ * The contents of an <ActionProperties> element, compiled for applying them repeatedly
+ * (when action lists are plugged, the properties of all clients are refreshed, or all clients
+ * of a component use the same shortcut scheme): the values are parsed once, and the type of a property is looked up once per action class
+ * rather than for every attribute.
+ */
+class ActionPropertiesTable
 {
 public:
-    enum ShortcutOption { SetActiveShortcut = 1, SetDefaultShortcut = 2};
+    ActionPropertiesTable() {}
+    explicit ActionPropertiesTable(const QDomElement &actionPropElement);
+
+    void apply(KXMLGUIClient *client, bool setDefaultShortcuts) const;
+
+    /*
+     * Removes the shortcut properties, and returns them with their action elements.
+     */
+    struct ElementShortcuts {
+        QDomElement element; // for KXMLGUIClient::action()
+        QList<QKeySequence> shortcuts;
+    };
+    QVector<ElementShortcuts> takeShortcuts();
+
+private:
+    struct Property {
+        QByteArray name;
+        QString value;
+        bool isIcon;
+        QIcon icon;
+        int intValue;
+        uint uintValue;
+        QList<QKeySequence> shortcuts;
+    };
+    struct Entry {
+        QDomElement element; // for KXMLGUIClient::action()
+        QVector<Property> properties;
+    };
+
+    void configureAction(QAction *action, const Property &property, bool setDefaultShortcuts) const;
+
+    QVector<Entry> m_entries;
+};
 
+class KXMLGUIFactoryPrivate : public BuildState
+{
+public:
     KXMLGUIFactoryPrivate()
+        : m_changeDepth(0), m_batchDepth(0)
     {
         m_rootNode = new ContainerNode(nullptr, QString(), QString());
         attrName = QStringLiteral("name");
@@ -76,19 +128,13 @@ public:
         BuildState::operator=(m_stateStack.pop());
     }
 
-    bool emptyState() const
-    {
-        return m_stateStack.isEmpty();
-    }
+    void beginChange(KXMLGUIFactory *q);
+    void endChange(KXMLGUIFactory *q);
 
+    QWidget *findContainer(const QString &containerName, KXMLGUIClient *client, bool useTagName);
     QWidget *findRecursive(KXMLGUI::ContainerNode *node, bool tag);
     QList<QWidget *> findRecursive(KXMLGUI::ContainerNode *node, const QString &tagName);
-    void applyActionProperties(const QDomElement &element,
-                               ShortcutOption shortcutOption = KXMLGUIFactoryPrivate::SetActiveShortcut);
-    void configureAction(QAction *action, const QDomNamedNodeMap &attributes,
-                         ShortcutOption shortcutOption = KXMLGUIFactoryPrivate::SetActiveShortcut);
-    void configureAction(QAction *action, const QDomAttr &attribute,
-                         ShortcutOption shortcutOption = KXMLGUIFactoryPrivate::SetActiveShortcut);
+    const ActionPropertiesTable &actionPropertiesTable(KXMLGUIClient *client, const QDomElement &actionPropElement);
 
     void applyShortcutScheme(const QString &schemeName, KXMLGUIClient *client, const QList<QAction *> &actions);
     void refreshActionProperties(KXMLGUIClient *client, const QList<QAction *> &actions, const QDomDocument &doc);
@@ -109,35 +155,91 @@ public:
     QString attrName;
 
     BuildStateStack m_stateStack;
+
+    /*
+     * Nesting depth of addClient/removeClient/replaceClient calls and batches,
+     * makingChanges is emitted when entering and leaving the outermost one.
+     */
+    int m_changeDepth;
+    QList<KXMLGUIClient *> m_addedClients;
+    QList<KXMLGUIClient *> m_removedClients;
+
+    int m_batchDepth;
+    QPointer<QWidget> m_suspendedWidget;
+
+    /*
+     * The compiled action properties of the clients' documents, see actionPropertiesTable().
+     */
+    struct CompiledActionProperties {
+        CompiledActionProperties() : revision(0) {}
+        QDomElement element;
+        quint64 revision; // see KXMLGUI::documentRevision()
+        ActionPropertiesTable table;
+    };
+    QHash<KXMLGUIClient *, CompiledActionProperties> m_actionProperties;
 };
 
-QString KXMLGUIFactory::readConfigFile(const QString &filename, const QString &_componentName)
+void KXMLGUIFactoryPrivate::beginChange(KXMLGUIFactory *q)
+{
+    if (m_changeDepth++ == 0) {
+        emit q->makingChanges(true);
+    }
+}
+
+void KXMLGUIFactoryPrivate::endChange(KXMLGUIFactory *q)
+{
+    if (--m_changeDepth > 0) {
+        return;
+    }
+
+    emit q->makingChanges(false);
+
+    if (!m_addedClients.isEmpty()) {
+        const QList<KXMLGUIClient *> added = m_addedClients;
+        m_addedClients.clear();
+        emit q->clientsAdded(added);
+    }
+    if (!m_removedClients.isEmpty()) {
+        const QList<KXMLGUIClient *> removed = m_removedClients;
+        m_removedClients.clear();
+        emit q->clientsRemoved(removed);
+    }
+}
+
+QByteArray KXMLGUIFactory::readConfigFileData(const QString &filename, const QString &_componentName)
 {
+    KXmlGuiProfiler::Phase phase("readConfigFile");
+
     QString componentName = _componentName.isEmpty() ? QCoreApplication::applicationName() : _componentName;
     QString xml_file;
 
     if (!QDir::isRelativePath(filename)) {
         xml_file = filename;
     } else {
+        KXmlGuiFileIndex *index = KXmlGuiFileIndex::self();
+
         // KF >= 5.1 (KXMLGUI_INSTALL_DIR)
-        xml_file = QStandardPaths::locate(QStandardPaths::GenericDataLocation, QStringLiteral("kxmlgui5/") + componentName + QLatin1Char('/') + filename);
-        if (!QFile::exists(xml_file)) {
+        xml_file = index->locate(QStringLiteral("kxmlgui5/") + componentName + QLatin1Char('/') + filename);
+        if (xml_file.isEmpty()) {
             // KF >= 5.4 (resource file)
-            xml_file = QStringLiteral(":/kxmlgui5/") + componentName + QLatin1Char('/') + filename;
+            const QString qrcFile = QStringLiteral(":/kxmlgui5/") + componentName + QLatin1Char('/') + filename;
+            if (QFile::exists(qrcFile)) {
+                xml_file = qrcFile;
+            }
         }
 
         bool warn = false;
-        if (!QFile::exists(xml_file)) {
+        if (xml_file.isEmpty()) {
             // kdelibs4 / KF 5.0 solution
-            xml_file = QStandardPaths::locate(QStandardPaths::GenericDataLocation, componentName + QLatin1Char('/') + filename);
+            xml_file = index->locate(componentName + QLatin1Char('/') + filename);
             warn = true;
         }
 
-        if (!QFile::exists(xml_file)) {
+        if (xml_file.isEmpty()) {
             // kdelibs4 / KF 5.0 solution, and the caller includes the component name
             // This was broken (lead to component/component/ in kdehome) and unnecessary
             // (they can specify it with setComponentName instead)
-            xml_file = QStandardPaths::locate(QStandardPaths::GenericDataLocation, filename);
+            xml_file = index->locate(filename);
             warn = true;
         }
 
@@ -146,19 +248,32 @@ QString KXMLGUIFactory::readConfigFile(const QString &filename, const QString &_
         }
     }
 
+    // a local file might still be being updated
+    if (!xml_file.isEmpty()) {
+        KXmlGuiVersionHandler::waitForPendingWrite(xml_file);
+    }
+
     QFile file(xml_file);
     if (xml_file.isEmpty() || !file.open(QIODevice::ReadOnly)) {
         qCritical() << "No such XML file" << filename;
-        return QString();
+        return QByteArray();
     }
 
-    QByteArray buffer(file.readAll());
+    return file.readAll();
+}
+
+QString KXMLGUIFactory::readConfigFile(const QString &filename, const QString &componentName)
+{
+    const QByteArray buffer = readConfigFileData(filename, componentName);
     return QString::fromUtf8(buffer.constData(), buffer.size());
 }
 
 bool KXMLGUIFactory::saveConfigFile(const QDomDocument &doc,
                                     const QString &filename, const QString &_componentName)
 {
+    // don't let an older background write overwrite this one
+    KXmlGuiVersionHandler::waitForPendingWrites();
+
     QString componentName = _componentName.isEmpty() ? QCoreApplication::applicationName() : _componentName;
     QString xml_file(filename);
 
@@ -180,6 +295,12 @@ bool KXMLGUIFactory::saveConfigFile(const QDomDocument &doc,
     ts << doc;
 
     file.close();
+
+    // the cached merged documents of this component may depend on that file
+    KXmlGuiFileIndex::self()->invalidate();
+    KXmlGuiCache::invalidate(componentName);
+    KXmlGuiPreloader::self()->invalidate(componentName);
+    KXmlGuiSharedDocuments::invalidate(componentName);
     return true;
 }
 
@@ -189,8 +310,8 @@ KXMLGUIFactory::KXMLGUIFactory(KXMLGUIBuilder *builder, QObject *parent)
     d->builder = builder;
     d->guiClient = nullptr;
     if (d->builder) {
-        d->builderContainerTags = d->builder->containerTags();
-        d->builderCustomTags = d->builder->customTags();
+        d->builderContainerTags = d->builder->containerTags().toSet();
+        d->builderCustomTags = d->builder->customTags().toSet();
     }
 }
 
@@ -213,12 +334,10 @@ void KXMLGUIFactory::addClient(KXMLGUIClient *client)
         }
     }
 
-    if (d->emptyState()) {
-        emit makingChanges(true);
-    }
-    d->pushState();
+    KXmlGuiProfiler::Phase phase("addClient", client);
 
-//    QTime dt; dt.start();
+    d->beginChange(this);
+    d->pushState();
 
     d->guiClient = client;
 
@@ -252,27 +371,38 @@ void KXMLGUIFactory::addClient(KXMLGUIClient *client)
     d->clientBuilder = client->clientBuilder();
 
     if (d->clientBuilder) {
-        d->clientBuilderContainerTags = d->clientBuilder->containerTags();
-        d->clientBuilderCustomTags = d->clientBuilder->customTags();
+        d->clientBuilderContainerTags = d->clientBuilder->containerTags().toSet();
+        d->clientBuilderCustomTags = d->clientBuilder->customTags().toSet();
     } else {
         d->clientBuilderContainerTags.clear();
         d->clientBuilderCustomTags.clear();
     }
 
     // load shortcut schemes, user-defined shortcuts and other action properties
-    d->saveDefaultActionProperties(client->actionCollection()->actions());
+    {
+        KXmlGuiProfiler::Phase phase("saveDefaultActionProperties");
+        d->saveDefaultActionProperties(client->actionCollection()->actions());
+    }
     if (!doc.isNull()) {
+        KXmlGuiProfiler::Phase phase("refreshActionProperties");
         d->refreshActionProperties(client, client->actionCollection()->actions(), doc);
     }
 
-    BuildHelper(*d, d->m_rootNode).build(docElement);
+    {
+        KXmlGuiProfiler::Phase phase("build");
+        BuildHelper(*d, d->m_rootNode).build(docElement);
+    }
 
     // let the client know that we built its GUI.
     client->setFactory(this);
 
     // call the finalizeGUI method, to fix up the positions of toolbars for example.
     // Note: the client argument is ignored
-    d->builder->finalizeGUI(d->guiClient);
+    // In a batch, this is done once at the end.
+    if (!d->m_batchDepth) {
+        KXmlGuiProfiler::Phase phase("finalizeGUI");
+        d->builder->finalizeGUI(d->guiClient);
+    }
 
     // reset some variables, for safety
     d->BuildState::reset();
@@ -282,15 +412,17 @@ void KXMLGUIFactory::addClient(KXMLGUIClient *client)
     d->popState();
 
     emit clientAdded(client);
+    // removed and added again during the same change: nothing changed for clientsAdded/Removed
+    if (!d->m_removedClients.removeOne(client)) {
+        d->m_addedClients.append(client);
+    }
 
     // build child clients
     Q_FOREACH (KXMLGUIClient *child, client->childClients()) {
         addClient(child);
     }
 
-    if (d->emptyState()) {
-        emit makingChanges(false);
-    }
+    d->endChange(this);
     /*
         QString unaddedActions;
         Q_FOREACH (KActionCollection* ac, KActionCollection::allCollections())
@@ -301,8 +433,6 @@ void KXMLGUIFactory::addClient(KXMLGUIClient *client)
         if (!unaddedActions.isEmpty())
           qCWarning(DEBUG_KXMLGUI) << "The following actions are not plugged into the gui (shortcuts will not work): " << unaddedActions;
     */
-
-//    qCDebug(DEBUG_KXMLGUI) << "addClient took " << dt.elapsed();
 }
 
 void KXMLGUIFactory::refreshActionProperties()
@@ -366,7 +496,7 @@ void KXMLGUIFactoryPrivate::refreshActionProperties(KXMLGUIClient *client, const
     // try to find and apply user-defined shortcuts
     const QDomElement actionPropElement = findActionPropertiesElement(doc);
     if (!actionPropElement.isNull()) {
-        applyActionProperties(actionPropElement);
+        actionPropertiesTable(client, actionPropElement).apply(client, false);
     }
 }
 
@@ -409,6 +539,10 @@ void KXMLGUIFactory::changeShortcutScheme(const QString &scheme)
 void KXMLGUIFactory::forgetClient(KXMLGUIClient *client)
 {
     d->m_clients.removeAll(client);
+    d->m_actionProperties.remove(client);
+    // the client is being deleted, don't report it at the end of the batch
+    d->m_addedClients.removeAll(client);
+    d->m_removedClients.removeAll(client);
 }
 
 void KXMLGUIFactory::removeClient(KXMLGUIClient *client)
@@ -420,12 +554,11 @@ void KXMLGUIFactory::removeClient(KXMLGUIClient *client)
         return;
     }
 
-    if (d->emptyState()) {
-        emit makingChanges(true);
-    }
+    d->beginChange(this);
 
     // remove this client from our client list
     d->m_clients.removeAll(client);
+    d->m_actionProperties.remove(client);
 
     // remove child clients first (create a copy of the list just in case the
     // original list is modified directly or indirectly in removeClient())
@@ -465,11 +598,83 @@ void KXMLGUIFactory::removeClient(KXMLGUIClient *client)
 
     d->popState();
 
-    if (d->emptyState()) {
-        emit makingChanges(false);
+    emit clientRemoved(client);
+    if (!d->m_addedClients.removeOne(client)) {
+        d->m_removedClients.append(client);
     }
 
-    emit clientRemoved(client);
+    d->endChange(this);
+}
+
+void KXMLGUIFactory::replaceClient(KXMLGUIClient *oldClient, KXMLGUIClient *newClient)
+{
+    if (oldClient == newClient) {
+        return;
+    }
+    if (!oldClient || oldClient->factory() != this) {
+        if (newClient) {
+            addClient(newClient);
+        }
+        return;
+    }
+    if (!newClient) {
+        removeClient(oldClient);
+        return;
+    }
+
+    d->beginChange(this);
+    d->pushState();
+
+    // containers the old client would remove are kept until the new client is built,
+    // which takes over those it defines as well
+    d->keepContainers = true;
+    removeClient(oldClient);
+    addClient(newClient);
+    d->m_rootNode->removePendingChildren();
+
+    d->popState();
+    d->endChange(this);
+}
+
+void KXMLGUIFactory::beginBatch()
+{
+    if (d->m_batchDepth++ == 0) {
+        // don't repaint and relayout the window after each change
+        QWidget *widget = d->builder ? d->builder->widget() : nullptr;
+        if (widget && widget->updatesEnabled()) {
+            widget->setUpdatesEnabled(false);
+            d->m_suspendedWidget = widget;
+        }
+    }
+    d->beginChange(this);
+}
+
+void KXMLGUIFactory::endBatch()
+{
+    if (d->m_batchDepth == 0) {
+        qCWarning(DEBUG_KXMLGUI) << "KXMLGUIFactory::endBatch called without beginBatch";
+        return;
+    }
+
+    if (--d->m_batchDepth == 0) {
+        // finalize the GUI once, for the last client added which is still there
+        if (d->builder) {
+            for (int i = d->m_addedClients.count() - 1; i >= 0; --i) {
+                KXMLGUIClient *client = d->m_addedClients.at(i);
+                if (d->m_clients.contains(client)) {
+                    KXmlGuiProfiler::Phase phase("finalizeGUI", client);
+                    d->builder->finalizeGUI(client);
+                    break;
+                }
+            }
+        }
+
+        if (d->m_suspendedWidget) {
+            d->m_suspendedWidget->setUpdatesEnabled(true);
+        }
+        d->m_suspendedWidget = nullptr;
+    }
+    d->endChange(this);
 }
 
 QList<KXMLGUIClient *> KXMLGUIFactory::clients() const
@@ -477,25 +682,65 @@ QList<KXMLGUIClient *> KXMLGUIFactory::clients() const
     return d->m_clients;
 }
 
+void KXMLGUIFactory::setLazyMenuPopulation(bool lazy)
+{
+    d->lazyMenuPopulation = lazy;
+    if (!lazy) {
+        d->m_rootNode->populatePending(nullptr);
+    }
+}
+
+bool KXMLGUIFactory::lazyMenuPopulation() const
+{
+    return d->lazyMenuPopulation;
+}
+
 QWidget *KXMLGUIFactory::container(const QString &containerName, KXMLGUIClient *client,
                                    bool useTagName)
 {
-    d->pushState();
-    d->m_containerName = containerName;
-    d->guiClient = client;
+    QWidget *result = d->findContainer(containerName, client, useTagName);
+    // it might be in a menu which wasn't populated yet
+    if (!result && d->m_rootNode->populatePending(client)) {
+        result = d->findContainer(containerName, client, useTagName);
+    }
+    return result;
+}
+
+QWidget *KXMLGUIFactoryPrivate::findContainer(const QString &containerName, KXMLGUIClient *client,
+                                              bool useTagName)
+{
+    if (!containerName.isEmpty()) {
+        // the root node indexes all containers, only walk the tree if the name is ambiguous
+        ContainerNode *match = nullptr;
+        int matches = 0;
+        Q_FOREACH (ContainerNode *node, m_rootNode->nodesNamed(containerName, useTagName)) {
+            if (!client || node->client == client) {
+                match = node;
+                ++matches;
+            }
+        }
+        if (matches <= 1) {
+            return match ? match->container : nullptr;
+        }
+    }
 
-    QWidget *result = d->findRecursive(d->m_rootNode, useTagName);
+    pushState();
+    m_containerName = containerName;
+    guiClient = client;
 
-    d->guiClient = nullptr;
-    d->m_containerName.clear();
+    QWidget *result = findRecursive(m_rootNode, useTagName);
 
-    d->popState();
+    guiClient = nullptr;
+    m_containerName.clear();
+
+    popState();
 
     return result;
 }
 
 QList<QWidget *> KXMLGUIFactory::containers(const QString &tagName)
 {
+    d->m_rootNode->populatePending(nullptr);
     return d->findRecursive(d->m_rootNode, tagName);
 }
 
@@ -571,7 +816,12 @@ void KXMLGUIFactory::plugActionList(KXMLGUIClient *client, const QString &name,
     d->actionList = actionList;
     d->clientName = client->domDocument().documentElement().attribute(d->attrName);
 
-    d->m_rootNode->plugActionList(*d);
+    // the action list may be in a menu which wasn't populated yet
+    d->m_rootNode->populateActionList(client, name);
+    const QString mergingName = QLatin1String("actionlist") + name;
+    Q_FOREACH (KXMLGUI::ContainerNode *node, d->m_rootNode->actionListNodes(name)) {
+        node->plugActionList(*d, node->findIndex(mergingName));
+    }
 
     // Load shortcuts for these new actions
     d->saveDefaultActionProperties(actionList);
@@ -581,6 +831,37 @@ void KXMLGUIFactory::plugActionList(KXMLGUIClient *client, const QString &name,
     d->popState();
 }
 
+void KXMLGUIFactory::replaceActionList(KXMLGUIClient *client, const QString &name,
+                                       const QList<QAction *> &actionList)
+{
+    d->pushState();
+    d->guiClient = client;
+    d->actionListName = name;
+    d->actionList = actionList;
+    d->clientName = client->domDocument().documentElement().attribute(d->attrName);
+
+    // the action list may be in a menu which wasn't populated yet
+    d->m_rootNode->populateActionList(client, name);
+    const QString mergingName = QLatin1String("actionlist") + name;
+    QSet<QAction *> previousActions;
+    Q_FOREACH (KXMLGUI::ContainerNode *node, d->m_rootNode->actionListNodes(name)) {
+        node->replaceActionList(*d, node->findIndex(mergingName), previousActions);
+    }
+
+    // Load shortcuts for the actions which weren't in the list already
+    QList<QAction *> newActions;
+    Q_FOREACH (QAction *action, actionList) {
+        if (!previousActions.contains(action)) {
+            newActions.append(action);
+        }
+    }
+    d->saveDefaultActionProperties(newActions);
+    d->refreshActionProperties(client, newActions, client->domDocument());
+
+    d->BuildState::reset();
+    d->popState();
+}
+
 void KXMLGUIFactory::unplugActionList(KXMLGUIClient *client, const QString &name)
 {
     d->pushState();
@@ -588,14 +869,16 @@ void KXMLGUIFactory::unplugActionList(KXMLGUIClient *client, const QString &name
     d->actionListName = name;
     d->clientName = client->domDocument().documentElement().attribute(d->attrName);
 
-    d->m_rootNode->unplugActionList(*d);
+    const QString mergingName = QLatin1String("actionlist") + name;
+    Q_FOREACH (KXMLGUI::ContainerNode *node, d->m_rootNode->actionListNodes(name)) {
+        node->unplugActionList(*d, node->findIndex(mergingName));
+    }
 
     d->BuildState::reset();
     d->popState();
 }
 
-void KXMLGUIFactoryPrivate::applyActionProperties(const QDomElement &actionPropElement,
-        ShortcutOption shortcutOption)
+ActionPropertiesTable::ActionPropertiesTable(const QDomElement &actionPropElement)
 {
     for (QDomElement e = actionPropElement.firstChildElement();
             !e.isNull(); e = e.nextSiblingElement()) {
@@ -603,85 +886,206 @@ void KXMLGUIFactoryPrivate::applyActionProperties(const QDomElement &actionPropE
             continue;
         }
 
-        QAction *action = guiClient->action(e);
-        if (!action) {
-            continue;
-        }
+        Entry entry;
+        entry.element = e;
+        const QDomNamedNodeMap attributes = e.attributes();
+        for (int i = 0; i < attributes.length(); i++) {
+            const QDomAttr attr = attributes.item(i).toAttr();
+            if (attr.isNull()) {
+                continue;
+            }
+
+            QString attrName = attr.name();
+            // If the attribute is a deprecated "accel", change to "shortcut".
+            if (equals(attrName, "accel")) {
+                attrName = QStringLiteral("shortcut");
+            }
+
+            // No need to re-set name, particularly since it's "objectName" in Qt4
+            if (equals(attrName, "name")) {
+                continue;
+            }
 
-        configureAction(action, e.attributes(), shortcutOption);
+            Property property;
+            property.name = attrName.toLatin1();
+            property.value = attr.value();
+            property.isIcon = equals(attrName, "icon");
+            if (property.isIcon) {
+                property.icon = QIcon::fromTheme(property.value);
+            }
+            // the type of the property is only known once we have the action
+            property.intValue = property.value.toInt();
+            property.uintValue = property.value.toUInt();
+            property.shortcuts = QKeySequence::listFromString(property.value);
+            entry.properties.append(property);
+        }
+        m_entries.append(entry);
     }
 }
 
-void KXMLGUIFactoryPrivate::configureAction(QAction *action, const QDomNamedNodeMap &attributes,
-        ShortcutOption shortcutOption)
+void ActionPropertiesTable::apply(KXMLGUIClient *client, bool setDefaultShortcuts) const
 {
-    for (int i = 0; i < attributes.length(); i++) {
-        QDomAttr attr = attributes.item(i).toAttr();
-        if (attr.isNull()) {
+    for (const Entry &entry : m_entries) {
+        QAction *action = client->action(entry.element);
+        if (!action) {
             continue;
         }
 
-        configureAction(action, attr, shortcutOption);
+        for (const Property &property : entry.properties) {
+            configureAction(action, property, setDefaultShortcuts);
+        }
     }
 }
 
-void KXMLGUIFactoryPrivate::configureAction(QAction *action, const QDomAttr &attribute,
-        ShortcutOption shortcutOption)
+QVector<ActionPropertiesTable::ElementShortcuts> ActionPropertiesTable::takeShortcuts()
 {
-    QString attrName = attribute.name();
-    // If the attribute is a deprecated "accel", change to "shortcut".
-    if (equals(attrName, "accel")) {
-        attrName = QStringLiteral("shortcut");
+    QVector<ElementShortcuts> shortcuts;
+    QMutableVectorIterator<Entry> entryIt(m_entries);
+    while (entryIt.hasNext()) {
+        Entry &entry = entryIt.next();
+        QMutableVectorIterator<Property> propertyIt(entry.properties);
+        while (propertyIt.hasNext()) {
+            const Property &property = propertyIt.next();
+            if (property.name == "shortcut") {
+                ElementShortcuts elementShortcuts;
+                elementShortcuts.element = entry.element;
+                elementShortcuts.shortcuts = property.shortcuts;
+                shortcuts.append(elementShortcuts);
+                propertyIt.remove();
+            }
+        }
+        if (entry.properties.isEmpty()) {
+            entryIt.remove();
+        }
     }
+    return shortcuts;
+}
 
-    // No need to re-set name, particularly since it's "objectName" in Qt4
-    if (equals(attrName, "name")) {
-        return;
+// Same as action->property(name).type(), looked up once per class for the declared properties
+static QVariant::Type propertyType(QAction *action, const QByteArray &name)
+{
+    typedef QPair<const QMetaObject *, QByteArray> Key;
+    static QHash<Key, QVariant::Type> s_declaredTypes;
+
+    const Key key(action->metaObject(), name);
+    QHash<Key, QVariant::Type>::const_iterator it = s_declaredTypes.constFind(key);
+    if (it != s_declaredTypes.constEnd()) {
+        return *it;
     }
+    const QVariant::Type type = action->property(name.constData()).type();
+    if (key.first->indexOfProperty(name.constData()) >= 0) {
+        s_declaredTypes.insert(key, type);
+    }
+    // else it's a dynamic property, which only this action might have
+    return type;
+}
 
-    if (equals(attrName, "icon")) {
-        action->setIcon(QIcon::fromTheme(attribute.value()));
+void ActionPropertiesTable::configureAction(QAction *action, const Property &property, bool setDefaultShortcuts) const
+{
+    if (property.isIcon) {
+        action->setIcon(property.icon);
         return;
     }
 
     QVariant propertyValue;
 
-    QVariant::Type propertyType = action->property(attrName.toLatin1().constData()).type();
+    QVariant::Type propertyType = ::propertyType(action, property.name);
     bool isShortcut = (propertyType == QVariant::KeySequence);
 
     if (propertyType == QVariant::Int) {
-        propertyValue = QVariant(attribute.value().toInt());
+        propertyValue = QVariant(property.intValue);
     } else if (propertyType == QVariant::UInt) {
-        propertyValue = QVariant(attribute.value().toUInt());
+        propertyValue = QVariant(property.uintValue);
     } else if (isShortcut) {
         // Setting the shortcut by property also sets the default shortcut (which is incorrect), so we have to do it directly
-        if (attrName == QStringLiteral("globalShortcut")) {
+        if (property.name == "globalShortcut") {
 #if HAVE_GLOBALACCEL
-            KGlobalAccel::self()->setShortcut(action, QKeySequence::listFromString(attribute.value()));
+            KGlobalAccel::self()->setShortcut(action, property.shortcuts);
 #endif
         } else {
-            action->setShortcuts(QKeySequence::listFromString(attribute.value()));
+            action->setShortcuts(property.shortcuts);
         }
-        if (shortcutOption & KXMLGUIFactoryPrivate::SetDefaultShortcut) {
-            action->setProperty("defaultShortcuts", QVariant::fromValue(QKeySequence::listFromString(attribute.value())));
+        if (setDefaultShortcuts) {
+            action->setProperty("defaultShortcuts", QVariant::fromValue(property.shortcuts));
         }
     } else {
-        propertyValue = QVariant(attribute.value());
+        propertyValue = QVariant(property.value);
     }
-    if (!isShortcut && !action->setProperty(attrName.toLatin1().constData(), propertyValue)) {
-        qCWarning(DEBUG_KXMLGUI) << "Error: Unknown action property " << attrName << " will be ignored!";
+    if (!isShortcut && !action->setProperty(property.name.constData(), propertyValue)) {
+        qCWarning(DEBUG_KXMLGUI) << "Error: Unknown action property " << QString::fromLatin1(property.name) << " will be ignored!";
     }
 }
 
-void KXMLGUIFactoryPrivate::applyShortcutScheme(const QString &schemeName, KXMLGUIClient *client, const QList<QAction *> &actions)
+const ActionPropertiesTable &KXMLGUIFactoryPrivate::actionPropertiesTable(KXMLGUIClient *client, const QDomElement &actionPropElement)
 {
-    //First clear all existing shortcuts
-    Q_FOREACH (QAction *action, actions) {
-        action->setShortcuts(QList<QKeySequence>());
-        // We clear the default shortcut as well because the shortcut scheme will set its own defaults
-        action->setProperty("defaultShortcuts", QVariant::fromValue(QList<QKeySequence>()));
+    CompiledActionProperties &compiled = m_actionProperties[client];
+    const quint64 revision = documentRevision(client);
+    if (compiled.element != actionPropElement || compiled.revision != revision) {
+        compiled.element = actionPropElement;
+        compiled.revision = revision;
+        compiled.table = ActionPropertiesTable(actionPropElement);
+    }
+    return compiled.table;
+}
+
+// The compiled shortcut scheme files, shared by all clients (of a component)
+struct CompiledShortcutScheme {
+    QDateTime lastModified;
+    QVector<ActionPropertiesTable::ElementShortcuts> shortcuts;
+    ActionPropertiesTable otherProperties; // rarely any
+    bool valid;
+};
+
+static const CompiledShortcutScheme &compiledShortcutScheme(const QString &schemeFileName, const QString &componentName)
+{
+    static QHash<QString, CompiledShortcutScheme> s_schemes;
+
+    const QDateTime lastModified = QFileInfo(schemeFileName).lastModified();
+    CompiledShortcutScheme &scheme = s_schemes[schemeFileName];
+    if (scheme.lastModified.isValid() && scheme.lastModified == lastModified) {
+        return scheme;
+    }
+    scheme.lastModified = lastModified;
+    scheme.shortcuts.clear();
+    scheme.otherProperties = ActionPropertiesTable();
+    scheme.valid = false;
+
+    QDomDocument document;
+    QFile schemeFile(schemeFileName);
+    if (schemeFile.open(QIODevice::ReadOnly)) {
+        qCDebug(DEBUG_KXMLGUI) << componentName << ": found shortcut scheme XML" << schemeFileName;
+        document.setContent(&schemeFile);
+    }
+
+    if (document.isNull()) {
+        return scheme;
+    }
+
+    QDomElement docElement = document.documentElement();
+    QDomElement actionPropElement = docElement.namedItem(QStringLiteral("ActionProperties")).toElement();
+
+    //Check if we really have the shortcut configuration here
+    if (!actionPropElement.isNull()) {
+        scheme.otherProperties = ActionPropertiesTable(actionPropElement);
+        scheme.shortcuts = scheme.otherProperties.takeShortcuts();
+        scheme.valid = true;
     }
+    return scheme;
+}
+
+// Sets the shortcuts and the default shortcuts of @p action, if they differ
+static void setSchemeShortcuts(QAction *action, const QList<QKeySequence> &shortcuts)
+{
+    if (action->shortcuts() != shortcuts) {
+        action->setShortcuts(shortcuts);
+    }
+    if (action->property("defaultShortcuts").value<QList<QKeySequence> >() != shortcuts) {
+        action->setProperty("defaultShortcuts", QVariant::fromValue(shortcuts));
+    }
+}
 
+void KXMLGUIFactoryPrivate::applyShortcutScheme(const QString &schemeName, KXMLGUIClient *client, const QList<QAction *> &actions)
+{
     // Find the document for the shortcut scheme using the current application path.
     // This allows to install a single XML file for a shortcut scheme for kdevelop
     // rather than 10.
@@ -691,33 +1095,36 @@ void KXMLGUIFactoryPrivate::applyShortcutScheme(const QString &schemeName, KXMLG
     if (schemeFileName.isEmpty()) {
         schemeFileName = KShortcutSchemesHelper::applicationShortcutSchemeFileName(schemeName);
     }
+    const CompiledShortcutScheme *scheme = nullptr;
     if (schemeFileName.isEmpty()) {
         qCWarning(DEBUG_KXMLGUI) << client->componentName() << ": shortcut scheme file not found:" << schemeName << "after trying" << QCoreApplication::applicationName() << "and" << client->componentName();
-        return;
+    } else {
+        scheme = &compiledShortcutScheme(schemeFileName, client->componentName());
     }
 
-    QDomDocument scheme;
-    QFile schemeFile(schemeFileName);
-    if (schemeFile.open(QIODevice::ReadOnly)) {
-        qCDebug(DEBUG_KXMLGUI) << client->componentName() << ": found shortcut scheme XML" << schemeFileName;
-        scheme.setContent(&schemeFile);
+    // The scheme replaces the shortcuts and the default shortcuts of the actions; those it
+    // doesn't mention get none. Only the actions which end up with other shortcuts are touched.
+    QHash<QAction *, const QList<QKeySequence> *> schemeShortcuts;
+    if (scheme && scheme->valid) {
+        for (int i = 0; i < scheme->shortcuts.count(); ++i) {
+            const ActionPropertiesTable::ElementShortcuts &elementShortcuts = scheme->shortcuts.at(i);
+            if (QAction *action = client->action(elementShortcuts.element)) {
+                schemeShortcuts.insert(action, &elementShortcuts.shortcuts);
+            }
+        }
     }
-
-    if (scheme.isNull()) {
-        return;
+    Q_FOREACH (QAction *action, actions) {
+        if (!schemeShortcuts.contains(action)) {
+            setSchemeShortcuts(action, QList<QKeySequence>());
+        }
+    }
+    for (QHash<QAction *, const QList<QKeySequence> *>::const_iterator it = schemeShortcuts.constBegin();
+            it != schemeShortcuts.constEnd(); ++it) {
+        setSchemeShortcuts(it.key(), *it.value());
     }
 
-    QDomElement docElement = scheme.documentElement();
-    QDomElement actionPropElement = docElement.namedItem(QStringLiteral("ActionProperties")).toElement();
-
-    //Check if we really have the shortcut configuration here
-    if (!actionPropElement.isNull()) {
-        //qCDebug(DEBUG_KXMLGUI) << "Applying shortcut scheme for XMLGUI client" << client->componentName();
-
-        //Apply all shortcuts we have
-        applyActionProperties(actionPropElement, KXMLGUIFactoryPrivate::SetDefaultShortcut);
-        //} else {
-        //qCDebug(DEBUG_KXMLGUI) << "Invalid shortcut scheme file";
+    if (scheme && scheme->valid) {
+        scheme->otherProperties.apply(client, true);
     }
 }
 
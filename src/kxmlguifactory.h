@@ -85,6 +85,14 @@ public:
     /// @internal
     static QString readConfigFile(const QString &filename,
                                   const QString &componentName = QString());
+    /**
+     * @internal
+     * Same as readConfigFile, but returns the raw (UTF-8) contents of the file,
+     * to avoid decoding it when it is going to be parsed anyway.
+     * @since 5.50
+     */
+    static QByteArray readConfigFileData(const QString &filename,
+                                         const QString &componentName = QString());
     /// @internal
     static bool saveConfigFile(const QDomDocument &doc, const QString &filename,
                                const QString &componentName = QString());
@@ -121,9 +129,105 @@ public:
      */
     void removeClient(KXMLGUIClient *client);
 
+    /**
+     * Replaces the GUI of @p oldClient with the GUI of @p newClient, like
+     * removeClient(oldClient) followed by addClient(newClient), but containers
+     * (menus, toolbars, etc.) which are defined the same way by both clients are
+     * kept instead of being deleted and created again; only the actions in them
+     * are unplugged and plugged.
+     *
+     * This is meant for switching between parts in a shell, where the parts
+     * usually share most of their containers.
+     *
+     * If @p oldClient wasn't added to this factory, this is the same as addClient(newClient).
+     * @since 5.50
+     */
+    void replaceClient(KXMLGUIClient *oldClient, KXMLGUIClient *newClient);
+
+    /**
+     * Starts a batch of changes, e.g. adding or removing many clients at once.
+     *
+     * Until the matching endBatch(), updates of the builder's widget (usually the main window)
+     * are suspended, KXMLGUIBuilder::finalizeGUI is not called, and makingChanges() is only emitted
+     * once at the beginning and once at the end. At the end, finalizeGUI is called once and
+     * clientsAdded() and clientsRemoved() are emitted with all the clients added and removed
+     * during the batch. clientAdded() and clientRemoved() are still emitted for every client.
+     *
+     * Batches can be nested, only the outermost one has an effect.
+     * @see Batch
+     * @since 5.50
+     */
+    void beginBatch();
+
+    /**
+     * Ends a batch of changes started with beginBatch().
+     * @since 5.50
+     */
+    void endBatch();
+
+    /**
+     * Calls beginBatch() on construction and endBatch() on destruction:
+     * \code
+     * {
+     *     KXMLGUIFactory::Batch batch(factory);
+     *     Q_FOREACH (KXMLGUIClient *plugin, plugins) {
+     *         factory->addClient(plugin);
+     *     }
+     * }
+     * \endcode
+     * @since 5.50
+     */
+    class Batch
+    {
+    public:
+        explicit Batch(KXMLGUIFactory *factory)
+            : m_factory(factory)
+        {
+            m_factory->beginBatch();
+        }
+        ~Batch()
+        {
+            m_factory->endBatch();
+        }
+
+    private:
+        Q_DISABLE_COPY(Batch)
+        KXMLGUIFactory *const m_factory;
+    };
+
+    /**
+     * Enables lazy population of submenus: when adding a client, menus inside the
+     * menubar or inside other menus are created empty, and their contents (actions,
+     * separators, submenus) are only built when the menu is about to be shown for the
+     * first time. This saves time at startup for applications with large menus.
+     *
+     * Keyboard shortcuts of the actions work anyway, since they don't depend on the menus.
+     *
+     * Looking up a container which wasn't built yet with container(), and plugging action
+     * lists, builds the pending menus as needed. Disabling lazy population builds all pending menus.
+     *
+     * It only affects the menus of clients added afterwards. The default is false.
+     * @since 5.50
+     */
+    void setLazyMenuPopulation(bool lazy);
+
+    /**
+     * @return whether lazy population of submenus is enabled
+     * @see setLazyMenuPopulation
+     * @since 5.50
+     */
+    bool lazyMenuPopulation() const;
+
     void plugActionList(KXMLGUIClient *client, const QString &name, const QList<QAction *> &actionList);
     void unplugActionList(KXMLGUIClient *client, const QString &name);
 
+    /**
+     * Replaces the actions of the action list @p name of @p client with @p actionList.
+     * See KXMLGUIClient::replaceActionList.
+     * @since 5.50
+     */
+    void replaceActionList(KXMLGUIClient *client, const QString &name, const QList<QAction *> &actionList);
+
     /**
      * Returns a list of all clients currently added to this factory
      */
@@ -203,6 +307,26 @@ Q_SIGNALS:
     void clientAdded(KXMLGUIClient *client);
     void clientRemoved(KXMLGUIClient *client);
 
+    /**
+     * Emitted once the factory is done making changes, with all the clients which
+     * were added: by an addClient() call, i.e. the client and its child clients,
+     * or during a batch (see beginBatch()).
+     * @since 5.50
+     */
+    void clientsAdded(const QList<KXMLGUIClient *> &clients);
+
+    /**
+     * Emitted once the factory is done making changes, with all the clients which
+     * were removed: by a removeClient() call, i.e. the client and its child clients,
+     * or during a batch (see beginBatch()).
+     *
+     * A client removed during a batch may have been deleted since, so the pointers
+     * must not be dereferenced, only compared. Clients added and removed again during
+     * the same batch are in neither clientsAdded() nor clientsRemoved().
+     * @since 5.50
+     */
+    void clientsRemoved(const QList<KXMLGUIClient *> &clients);
+
     /**
      * Emitted when the factory is currently making changes to the GUI,
      * i.e. adding or removing clients.
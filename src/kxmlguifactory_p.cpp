@@ -18,55 +18,280 @@
 */
 
 #include "kxmlguifactory_p.h"
+#include "kxmlguiprofiler_p.h"
 
 #include "kxmlguiclient.h"
 #include "kxmlguibuilder.h"
 #include "ktoolbar.h"
 
+#include <QHash>
+#include <QMenu>
+#include <QMenuBar>
+#include <QVector>
 #include <QWidget>
 #include <QDebug>
 
 #include "debug.h"
 #include <assert.h>
 
+#include <algorithm>
+
 using namespace KXMLGUI;
 
 void ActionList::plug(QWidget *container, int index) const
 {
     QAction *before = nullptr; // Insert after end of widget's current actions (default).
 
-    if ((index < 0) || (index > container->actions().count())) {
-        qCWarning(DEBUG_KXMLGUI) << "Index " << index << " is not within range (0 - " << container->actions().count() << ")";
-    } else if (index != container->actions().count()) {
-        before = container->actions().at(index);    // Insert before indexed action.
+    const QList<QAction *> containerActions = container->actions();
+    if ((index < 0) || (index > containerActions.count())) {
+        qCWarning(DEBUG_KXMLGUI) << "Index " << index << " is not within range (0 - " << containerActions.count() << ")";
+    } else if (index != containerActions.count()) {
+        before = containerActions.at(index);    // Insert before indexed action.
     }
 
-    Q_FOREACH (QAction *action, *this) {
-        container->insertAction(before, action);
-        // before = action; // BUG FIX: do not insert actions in reverse order.
+    container->insertActions(before, *this);
+}
+
+TagInfo KXMLGUI::tagInfo(const QString &tagName)
+{
+    static QHash<QString, TagInfo> s_tags;
+
+    QHash<QString, TagInfo>::const_iterator it = s_tags.constFind(tagName);
+    if (it != s_tags.constEnd()) {
+        return *it;
     }
+
+    TagInfo info;
+    const QString lowerName = tagName.toLower();
+    if (lowerName != tagName) {
+        // share the lower case string between all spellings
+        info = tagInfo(lowerName);
+    } else {
+        static const struct {
+            const char *name;
+            ElementTag tag;
+        } knownTags[] = {
+            { "action", ActionTag },
+            { "merge", MergeTag },
+            { "definegroup", DefineGroupTag },
+            { "actionlist", ActionListTag },
+            { "state", StateTag },
+            { "enable", EnableTag },
+            { "disable", DisableTag }
+        };
+        info.name = lowerName;
+        info.tag = OtherTag;
+        for (const auto &known : knownTags) {
+            if (lowerName == QLatin1String(known.name)) {
+                info.tag = known.tag;
+                break;
+            }
+        }
+    }
+    s_tags.insert(tagName, info);
+    return info;
 }
 
 ContainerNode::ContainerNode(QWidget *_container, const QString &_tagName,
                              const QString &_name, ContainerNode *_parent,
                              KXMLGUIClient *_client, KXMLGUIBuilder *_builder,
                              QAction *_containerAction, const QString &_mergingName,
-                             const QString &_groupName, const QStringList &customTags,
-                             const QStringList &containerTags)
+                             const QString &_groupName, const QSet<QString> &customTags,
+                             const QSet<QString> &containerTags)
     : parent(_parent), client(_client), builder(_builder),
       builderCustomTags(customTags), builderContainerTags(containerTags),
       container(_container), containerAction(_containerAction), tagName(_tagName), name(_name),
-      groupName(_groupName), index(0), mergingName(_mergingName)
+      groupName(_groupName), index(0), mergingName(_mergingName),
+      pendingRemoval(false), pendingClient(nullptr), populated(true)
 {
     if (parent) {
         parent->children.append(this);
+        parent->childrenByTag[tagName].append(this);
+        if (!name.isEmpty()) {
+            parent->childrenByName[name].append(this);
+        }
+
+        ContainerNode *root = rootNode();
+        root->nodesByTag[tagName].append(this);
+        if (!name.isEmpty()) {
+            root->nodesByName[name].append(this);
+        }
+    }
+}
+
+static void removeFromIndex(QHash<QString, ContainerNodeList> &index, const QString &key, ContainerNode *node)
+{
+    QHash<QString, ContainerNodeList>::iterator it = index.find(key);
+    if (it != index.end()) {
+        it.value().removeOne(node);
+        if (it.value().isEmpty()) {
+            index.erase(it);
+        }
     }
 }
 
 ContainerNode::~ContainerNode()
 {
+    QObject::disconnect(populateConnection);
+    qDeleteAll(pendingBuilds);
     qDeleteAll(children);
     qDeleteAll(clients);
+
+    if (parent) {
+        ContainerNode *root = rootNode();
+        if (!pendingBuilds.isEmpty()) {
+            root->pendingNodes.removeOne(this);
+        }
+        removeFromIndex(root->nodesByTag, tagName, this);
+        if (!name.isEmpty()) {
+            removeFromIndex(root->nodesByName, name, this);
+        }
+        Q_FOREACH (const MergingIndex &idx, mergingIndices) {
+            removeFromIndex(root->nodesByActionList, idx.mergingName, this);
+        }
+    }
+}
+
+ContainerNode *ContainerNode::rootNode()
+{
+    ContainerNode *root = this;
+    while (root->parent) {
+        root = root->parent;
+    }
+    return root;
+}
+
+void ContainerNode::unindexChild(ContainerNode *child)
+{
+    removeFromIndex(childrenByTag, child->tagName, child);
+    if (!child->name.isEmpty()) {
+        removeFromIndex(childrenByName, child->name, child);
+    }
+}
+
+/*
+ * Keeps the element for later, it's built into this container by populate().
+ */
+void ContainerNode::defer(const BuildState &state, const QDomElement &element)
+{
+    PendingBuild *build = new PendingBuild;
+    build->state = state;
+    build->state.keepContainers = false;
+    build->element = element;
+    if (pendingBuilds.isEmpty()) {
+        rootNode()->pendingNodes.append(this);
+    }
+    pendingBuilds.append(build);
+
+    populated = false;
+    if (!populateConnection) {
+        QMenu *menu = qobject_cast<QMenu *>(container);
+        Q_ASSERT(menu);
+        populateConnection = QObject::connect(menu, &QMenu::aboutToShow, [this]() {
+            populate();
+        });
+    }
+}
+
+void ContainerNode::populate()
+{
+    QObject::disconnect(populateConnection);
+    populated = true;
+
+    if (pendingBuilds.isEmpty()) {
+        return;
+    }
+    rootNode()->pendingNodes.removeOne(this);
+
+    const QList<PendingBuild *> builds = pendingBuilds;
+    pendingBuilds.clear();
+    Q_FOREACH (PendingBuild *build, builds) {
+        // a deferred part of the client's build
+        KXmlGuiProfiler::Phase phase("build", build->state.guiClient);
+        BuildHelper(build->state, this).build(build->element);
+    }
+    qDeleteAll(builds);
+}
+
+/*
+ * Populates the containers in which @p client, or any client if it's null, has something
+ * left to build, and the submenus they defer in turn. Returns true if something was populated.
+ * Only call this on the root node.
+ */
+bool ContainerNode::populatePending(KXMLGUIClient *client)
+{
+    bool result = false;
+    Q_FOREVER {
+        // populating removes the node from pendingNodes, and may append its submenus
+        ContainerNode *next = nullptr;
+        Q_FOREACH (ContainerNode *node, pendingNodes) {
+            if (!client || node->hasPendingBuilds(client)) {
+                next = node;
+                break;
+            }
+        }
+        if (!next) {
+            return result;
+        }
+        next->populate();
+        result = true;
+    }
+}
+
+/*
+ * Populates the containers in which @p client has the action list @p actionListName
+ * left to build, so that it can be plugged. Other menus stay as they are.
+ * Only call this on the root node.
+ */
+void ContainerNode::populateActionList(KXMLGUIClient *client, const QString &actionListName)
+{
+    Q_FOREVER {
+        ContainerNode *next = nullptr;
+        Q_FOREACH (ContainerNode *node, pendingNodes) {
+            if (node->hasPendingActionList(client, actionListName)) {
+                next = node;
+                break;
+            }
+        }
+        if (!next) {
+            return;
+        }
+        next->populate();
+    }
+}
+
+bool ContainerNode::hasPendingBuilds(KXMLGUIClient *client) const
+{
+    return std::any_of(pendingBuilds.constBegin(), pendingBuilds.constEnd(),
+                       [client](PendingBuild *build) { return build->state.guiClient == client; });
+}
+
+bool ContainerNode::hasPendingActionList(KXMLGUIClient *client, const QString &actionListName) const
+{
+    return std::any_of(pendingBuilds.constBegin(), pendingBuilds.constEnd(),
+                       [client, &actionListName](PendingBuild *build) {
+                           return build->state.guiClient == client && build->hasActionList(actionListName);
+                       });
+}
+
+static void findActionLists(const QDomElement &element, QSet<QString> &names)
+{
+    for (QDomElement e = element.firstChildElement(); !e.isNull(); e = e.nextSiblingElement()) {
+        if (tagInfo(e.tagName()).tag == ActionListTag) {
+            names.insert(e.attribute(QStringLiteral("name")));
+        } else {
+            findActionLists(e, names);
+        }
+    }
+}
+
+bool PendingBuild::hasActionList(const QString &name)
+{
+    if (!actionListsFound) {
+        findActionLists(element, actionLists);
+        actionListsFound = true;
+    }
+    return actionLists.contains(name);
 }
 
 void ContainerNode::removeChild(ContainerNode *child)
@@ -77,6 +302,7 @@ void ContainerNode::removeChild(ContainerNode *child)
 
 void ContainerNode::deleteChild(ContainerNode *child)
 {
+    unindexChild(child);
     MergingIndexList::iterator mergingIt = findIndex(child->mergingName);
     adjustMergingIndices(-1, mergingIt, QString());
     delete child;
@@ -99,6 +325,14 @@ MergingIndexList::iterator ContainerNode::findIndex(const QString &name)
  */
 ContainerNode *ContainerNode::findContainer(const QString &_name, bool tag)
 {
+    if (!parent && !_name.isEmpty()) {
+        // the root node knows all nodes, only search if it's ambiguous
+        const ContainerNodeList nodes = nodesNamed(_name, tag);
+        if (nodes.count() <= 1) {
+            return nodes.value(0);
+        }
+    }
+
     if ((tag && tagName == _name) ||
             (!tag && name == _name)) {
         return this;
@@ -114,72 +348,76 @@ ContainerNode *ContainerNode::findContainer(const QString &_name, bool tag)
     return nullptr;
 }
 
+/*
+ * Returns all nodes of the tree with the given name or tag name, in no particular order.
+ * Only available in the root node.
+ */
+ContainerNodeList ContainerNode::nodesNamed(const QString &name, bool tag) const
+{
+    Q_ASSERT(!parent);
+    return tag ? nodesByTag.value(name) : nodesByName.value(name);
+}
+
 /*
  * Finds a child container node (not recursively) with the given name and tagname. Explicitly
  * leaves out container widgets specified in the exludeList . Also ensures that the containers
  * belongs to currClient.
  */
 ContainerNode *ContainerNode::findContainer(const QString &name, const QString &tagName,
-        const QList<QWidget *> *excludeList,
+        const QSet<QWidget *> *excludeList,
         KXMLGUIClient * /*currClient*/)
 {
-    ContainerNode *res = nullptr;
-    ContainerNodeList::ConstIterator nIt = children.constBegin();
-
+    QHash<QString, ContainerNodeList>::const_iterator it;
     if (!name.isEmpty()) {
-        for (; nIt != children.constEnd(); ++nIt)
-            if ((*nIt)->name == name &&
-                    !excludeList->contains((*nIt)->container)) {
-                res = *nIt;
-                break;
-            }
-
-        return res;
-    }
-
-    if (!tagName.isEmpty())
-        for (; nIt != children.constEnd(); ++nIt) {
-            if ((*nIt)->tagName == tagName &&
-                    !excludeList->contains((*nIt)->container)
-                    /*
-                     * It is a bad idea to also compare the client, because
-                     * we don't want to do so in situations like these:
-                     *
-                     * <MenuBar>
-                     *   <Menu>
-                     *     ...
-                     *
-                     * other client:
-                     * <MenuBar>
-                     *   <Menu>
-                     *    ...
-                     *
-                    && (*nIt)->client == currClient )
-                    */
-               ) {
-                res = *nIt;
-                break;
-            }
+        it = childrenByName.constFind(name);
+        if (it == childrenByName.constEnd()) {
+            return nullptr;
         }
+    } else if (!tagName.isEmpty()) {
+        /*
+         * It is a bad idea to also compare the client, because
+         * we don't want to do so in situations like these:
+         *
+         * <MenuBar>
+         *   <Menu>
+         *     ...
+         *
+         * other client:
+         * <MenuBar>
+         *   <Menu>
+         *    ...
+         */
+        it = childrenByTag.constFind(tagName);
+        if (it == childrenByTag.constEnd()) {
+            return nullptr;
+        }
+    } else {
+        return nullptr;
+    }
 
-    return res;
+    Q_FOREACH (ContainerNode *node, it.value()) {
+        if (!excludeList->contains(node->container)) {
+            return node;
+        }
+    }
+    return nullptr;
 }
 
 ContainerClient *ContainerNode::findChildContainerClient(KXMLGUIClient *currentGUIClient,
         const QString &groupName,
         const MergingIndexList::iterator &mergingIdx)
 {
-    if (!clients.isEmpty()) {
-        Q_FOREACH (ContainerClient *client, clients)
-            if (client->client == currentGUIClient) {
-                if (groupName.isEmpty()) {
-                    return client;
-                }
+    const QHash<KXMLGUIClient *, ContainerClientList>::const_iterator it = clientsByGuiClient.constFind(currentGUIClient);
+    if (it != clientsByGuiClient.constEnd()) {
+        Q_FOREACH (ContainerClient *client, it.value()) {
+            if (groupName.isEmpty()) {
+                return client;
+            }
 
-                if (groupName == client->groupName) {
-                    return client;
-                }
+            if (groupName == client->groupName) {
+                return client;
             }
+        }
     }
 
     ContainerClient *client = new ContainerClient;
@@ -191,27 +429,41 @@ ContainerClient *ContainerNode::findChildContainerClient(KXMLGUIClient *currentG
     }
 
     clients.append(client);
+    clientsByGuiClient[currentGUIClient].append(client);
 
     return client;
 }
 
-void ContainerNode::plugActionList(BuildState &state)
+void ContainerNode::indexActionList(const QString &mergingName)
 {
-    MergingIndexList::iterator mIt(mergingIndices.begin());
-    MergingIndexList::iterator mEnd(mergingIndices.end());
-    for (; mIt != mEnd; ++mIt) {
-        plugActionList(state, mIt);
+    ContainerNodeList &nodes = rootNode()->nodesByActionList[mergingName];
+    if (!nodes.contains(this)) {
+        nodes.append(this);
     }
+}
 
-    Q_FOREACH (ContainerNode *child, children) {
-        child->plugActionList(state);
-    }
+void ContainerNode::unindexActionList(const QString &mergingName)
+{
+    removeFromIndex(rootNode()->nodesByActionList, mergingName, this);
+}
+
+/*
+ * The nodes which have an <ActionList name="@p actionListName">, of any client.
+ * Only call this on the root node.
+ */
+ContainerNodeList ContainerNode::actionListNodes(const QString &actionListName)
+{
+    return nodesByActionList.value(QLatin1String("actionlist") + actionListName);
 }
 
 void ContainerNode::plugActionList(BuildState &state, const MergingIndexList::iterator &mergingIdxIt)
 {
     static const QString &tagActionList = QLatin1String("actionlist");
 
+    if (mergingIdxIt == mergingIndices.end()) {
+        return;
+    }
+
     const MergingIndex &mergingIdx = *mergingIdxIt;
     if (mergingIdx.clientName != state.clientName) {
         return;
@@ -235,23 +487,14 @@ void ContainerNode::plugActionList(BuildState &state, const MergingIndexList::it
     adjustMergingIndices(state.actionList.count(), mergingIdxIt, QString());
 }
 
-void ContainerNode::unplugActionList(BuildState &state)
-{
-    MergingIndexList::iterator mIt(mergingIndices.begin());
-    MergingIndexList::iterator mEnd(mergingIndices.end());
-    for (; mIt != mEnd; ++mIt) {
-        unplugActionList(state, mIt);
-    }
-
-    Q_FOREACH (ContainerNode *child, children) {
-        child->unplugActionList(state);
-    }
-}
-
 void ContainerNode::unplugActionList(BuildState &state, const MergingIndexList::iterator &mergingIdxIt)
 {
     static const QString &tagActionList = QStringLiteral("actionlist");
 
+    if (mergingIdxIt == mergingIndices.end()) {
+        return;
+    }
+
     MergingIndex mergingIdx = *mergingIdxIt;
 
     QString k = mergingIdx.mergingName;
@@ -284,6 +527,127 @@ void ContainerNode::unplugActionList(BuildState &state, const MergingIndexList::
     client->actionLists.erase(lIt);
 }
 
+/*
+ * Returns the actions of @p newList to keep in place when replacing @p oldList: the longest
+ * sequence of actions which appear in both lists in the same order.
+ */
+static QSet<QAction *> unmovedActions(const QList<QAction *> &oldList, const QList<QAction *> &newList)
+{
+    QHash<QAction *, int> oldPositions;
+    oldPositions.reserve(oldList.count());
+    for (int i = 0; i < oldList.count(); ++i) {
+        oldPositions.insert(oldList.at(i), i);
+    }
+
+    // longest increasing subsequence of the old positions, in the order of the new list
+    QVector<int> positions; // old positions of the common actions, in new order
+    QVector<QAction *> common;
+    for (QAction *action : newList) {
+        const int position = oldPositions.value(action, -1);
+        if (position >= 0) {
+            positions.append(position);
+            common.append(action);
+        }
+    }
+    QVector<int> tails; // index in positions of the last element of the best sequence of length i + 1
+    QVector<int> previous(positions.count(), -1);
+    for (int i = 0; i < positions.count(); ++i) {
+        const QVector<int>::iterator it = std::lower_bound(tails.begin(), tails.end(), positions.at(i),
+                                          [&positions](int tail, int position) { return positions.at(tail) < position; });
+        if (it != tails.begin()) {
+            previous[i] = *(it - 1);
+        }
+        if (it == tails.end()) {
+            tails.append(i);
+        } else {
+            *it = i;
+        }
+    }
+
+    QSet<QAction *> result;
+    for (int i = tails.isEmpty() ? -1 : tails.last(); i >= 0; i = previous.at(i)) {
+        result.insert(common.at(i));
+    }
+    return result;
+}
+
+/*
+ * Same as unplugActionList() followed by plugActionList(), but only the actions which aren't
+ * in both lists (in the same order) are removed and inserted, and the merging indices are
+ * adjusted once. The actions of the old list are added to @p previousActions.
+ */
+void ContainerNode::replaceActionList(BuildState &state, const MergingIndexList::iterator &mergingIdxIt,
+                                      QSet<QAction *> &previousActions)
+{
+    static const QString &tagActionList = QLatin1String("actionlist");
+
+    if (mergingIdxIt == mergingIndices.end()) {
+        return;
+    }
+
+    const MergingIndex &mergingIdx = *mergingIdxIt;
+    if (mergingIdx.clientName != state.clientName) {
+        return;
+    }
+    if (!mergingIdx.mergingName.startsWith(tagActionList)) {
+        return;
+    }
+    const QString k = mergingIdx.mergingName.mid(tagActionList.length());
+    if (k != state.actionListName) {
+        return;
+    }
+
+    ContainerClient *client = findChildContainerClient(state.guiClient,
+                              QString(),
+                              mergingIndices.end());
+
+    // the old list might contain actions which were deleted meanwhile, and
+    // new actions might have been allocated at the same address since
+    const QList<QAction *> containerActions = container->actions();
+    const QSet<QAction *> plugged = containerActions.toSet();
+    QList<QAction *> oldList;
+    Q_FOREACH (QAction *action, client->actionLists.value(k)) {
+        if (plugged.contains(action)) {
+            oldList.append(action);
+        }
+    }
+    previousActions += oldList.toSet();
+
+    const QSet<QAction *> unmoved = unmovedActions(oldList, state.actionList);
+
+    // the list ends right before the merging index
+    QAction *end = mergingIdx.value < containerActions.count() ? containerActions.at(mergingIdx.value) : nullptr;
+
+    int offset = 0;
+    Q_FOREACH (QAction *action, oldList) {
+        if (!unmoved.contains(action)) {
+            container->removeAction(action);
+            --offset;
+        }
+    }
+
+    QList<QAction *> inserted;
+    Q_FOREACH (QAction *action, state.actionList) {
+        if (unmoved.contains(action)) {
+            container->insertActions(action, inserted);
+            offset += inserted.count();
+            inserted.clear();
+        } else {
+            inserted.append(action);
+        }
+    }
+    container->insertActions(end, inserted);
+    offset += inserted.count();
+
+    if (state.actionList.isEmpty()) {
+        client->actionLists.remove(k);
+    } else {
+        client->actionLists.insert(k, state.actionList);
+    }
+
+    adjustMergingIndices(offset, mergingIdxIt, QString());
+}
+
 void ContainerNode::adjustMergingIndices(int offset,
                                          const MergingIndexList::iterator &it,
                                          const QString &currentClientName)
@@ -306,16 +670,38 @@ bool ContainerNode::destruct(QDomElement element, BuildState &state)   //krazy:e
 
     unplugActions(state);
 
+    // forget what the client didn't build yet
+    QMutableListIterator<PendingBuild *> buildIt(pendingBuilds);
+    while (buildIt.hasNext()) {
+        PendingBuild *build = buildIt.next();
+        if (build->state.guiClient == state.guiClient) {
+            delete build;
+            buildIt.remove();
+            if (pendingBuilds.isEmpty()) {
+                rootNode()->pendingNodes.removeOne(this);
+            }
+        }
+    }
+
     // remove all merging indices the client defined
     QMutableVectorIterator<MergingIndex> cmIt = mergingIndices;
     while (cmIt.hasNext())
         if (cmIt.next().clientName == state.clientName) {
+            unindexActionList(cmIt.value().mergingName);
             cmIt.remove();
         }
 
     // ### check for merging index count, too?
-    if (clients.isEmpty() && children.isEmpty() && container &&
+    if (clients.isEmpty() && !hasActiveChildren() && pendingBuilds.isEmpty() && container &&
             client == state.guiClient) {
+        if (state.keepContainers) {
+            pendingRemoval = true;
+            pendingClient = client;
+            pendingElement = element;
+            client = nullptr;
+            return false;
+        }
+
         QWidget *parentContainer = nullptr;
         if (parent && parent->container) {
             parentContainer = parent->container;
@@ -351,14 +737,48 @@ void ContainerNode::destructChildren(const QDomElement &element, BuildState &sta
     }
 }
 
+bool ContainerNode::hasActiveChildren() const
+{
+    return std::any_of(children.constBegin(), children.constEnd(),
+                       [](ContainerNode *child) { return !child->pendingRemoval; });
+}
+
+/*
+ * Removes the containers which were kept while replacing a client, but which
+ * the new client didn't take over.
+ */
+void ContainerNode::removePendingChildren()
+{
+    QMutableListIterator<ContainerNode *> childIt = children;
+    while (childIt.hasNext()) {
+        ContainerNode *childNode = childIt.next();
+
+        childNode->removePendingChildren();
+
+        if (!childNode->pendingRemoval) {
+            continue;
+        }
+
+        if (childNode->children.isEmpty() && childNode->clients.isEmpty() && childNode->pendingBuilds.isEmpty()) {
+            Q_ASSERT(childNode->builder);
+            childNode->builder->removeContainer(childNode->container, container,
+                                                childNode->pendingElement, childNode->containerAction);
+            deleteChild(childNode);
+            childIt.remove();
+        } else {
+            // still in use, keep it without owner, like destruct() does
+            childNode->pendingRemoval = false;
+            childNode->pendingClient = nullptr;
+            childNode->pendingElement = QDomElement();
+        }
+    }
+}
+
 QDomElement ContainerNode::findElementForChild(const QDomElement &baseElement,
         ContainerNode *childNode)
 {
-    // ### slow
-    for (QDomNode n = baseElement.firstChild(); !n.isNull();
-            n = n.nextSibling()) {
-        QDomElement e = n.toElement();
-        if (e.tagName().toLower() == childNode->tagName &&
+    for (QDomElement e = baseElement.firstChildElement(); !e.isNull(); e = e.nextSiblingElement()) {
+        if (tagInfo(e.tagName()).name == childNode->tagName &&
                 e.attribute(QStringLiteral("name")) == childNode->name) {
             return e;
         }
@@ -384,22 +804,45 @@ void ContainerNode::unplugActions(BuildState &state)
             clientIt.remove();
         }
     }
+    clientsByGuiClient.remove(state.guiClient);
 }
 
 void ContainerNode::removeActions(const QList<QAction *> &actions)
 {
+    if (actions.isEmpty()) {
+        return;
+    }
+
+    // Look up all positions at once, rather than calling actions().indexOf() (which copies the list)
+    // and walking the merging indices for every single action.
+    const QList<QAction *> containerActions = container->actions();
+    QHash<QAction *, int> positionOf;
+    positionOf.reserve(containerActions.count());
+    for (int i = 0; i < containerActions.count(); ++i) {
+        positionOf.insert(containerActions.at(i), i);
+    }
+
+    QVector<int> removedPositions;
+    removedPositions.reserve(actions.count());
     for (QAction *action : actions) {
-        const int pos = container->actions().indexOf(action);
-        if (pos != -1) {
+        QHash<QAction *, int>::iterator it = positionOf.find(action);
+        if (it != positionOf.end()) {
+            removedPositions.append(it.value());
+            positionOf.erase(it); // in case it's listed twice
             container->removeAction(action);
-            for (MergingIndex &idx : mergingIndices) {
-                if (idx.value > pos) {
-                    --idx.value;
-                }
-            }
-            --index;
         }
     }
+    if (removedPositions.isEmpty()) {
+        return;
+    }
+    std::sort(removedPositions.begin(), removedPositions.end());
+
+    // every index moves back by the number of actions removed before it
+    for (MergingIndex &idx : mergingIndices) {
+        idx.value -= std::lower_bound(removedPositions.constBegin(), removedPositions.constEnd(), idx.value)
+                     - removedPositions.constBegin();
+    }
+    index -= removedPositions.count();
 }
 
 void ContainerNode::unplugClient(ContainerClient *client)
@@ -495,22 +938,8 @@ int BuildHelper::calcMergingIndex(const QDomElement &element, MergingIndexList::
 
 BuildHelper::BuildHelper(BuildState &state, ContainerNode *node)
     : containerClient(nullptr), ignoreDefaultMergingIndex(false), m_state(state),
-      parentNode(node)
+      parentNode(node), pendingIndex(0), pendingClient(nullptr)
 {
-    // create a list of supported container and custom tags
-    customTags = m_state.builderCustomTags;
-    containerTags = m_state.builderContainerTags;
-
-    if (parentNode->builder != m_state.builder) {
-        customTags += parentNode->builderCustomTags;
-        containerTags += parentNode->builderContainerTags;
-    }
-
-    if (m_state.clientBuilder) {
-        customTags = m_state.clientBuilderCustomTags + customTags;
-        containerTags = m_state.clientBuilderContainerTags + containerTags;
-    }
-
     m_state.currentDefaultMergingIt = parentNode->findIndex(QStringLiteral("<default>"));
     parentNode->calcMergingIndex(QString(), m_state.currentClientMergingIt,
                                  m_state, /*ignoreDefaultMergingIndex*/ false);
@@ -525,23 +954,43 @@ void BuildHelper::build(const QDomElement &element)
         }
         processElement(e);
     }
+    flushPendingActions();
+}
+
+// the supported custom and container tags are the ones of the client's builder, the
+// factory's builder and the builder which created the parent container
+bool BuildHelper::isCustomTag(const QString &tag) const
+{
+    return (m_state.clientBuilder && m_state.clientBuilderCustomTags.contains(tag))
+           || m_state.builderCustomTags.contains(tag)
+           || (parentNode->builder != m_state.builder && parentNode->builderCustomTags.contains(tag));
+}
+
+bool BuildHelper::isContainerTag(const QString &tag) const
+{
+    return (m_state.clientBuilder && m_state.clientBuilderContainerTags.contains(tag))
+           || m_state.builderContainerTags.contains(tag)
+           || (parentNode->builder != m_state.builder && parentNode->builderContainerTags.contains(tag));
 }
 
 void BuildHelper::processElement(const QDomElement &e)
 {
-    QString tag(e.tagName().toLower());
-    QString currName(e.attribute(QStringLiteral("name")));
+    const TagInfo info = tagInfo(e.tagName());
 
-    bool isActionTag = (tag == QStringLiteral("action"));
+    bool isActionTag = (info.tag == ActionTag);
 
-    if (isActionTag || customTags.indexOf(tag) != -1) {
+    if (!isActionTag) {
+        // everything else may need the merging indices to be up to date
+        flushPendingActions();
+    }
+
+    if (isActionTag || isCustomTag(info.name)) {
         processActionOrCustomElement(e, isActionTag);
-    } else if (containerTags.indexOf(tag) != -1) {
-        processContainerElement(e, tag, currName);
-    } else if (tag == QStringLiteral("merge") || tag == QLatin1String("definegroup")
-               || tag == QStringLiteral("actionlist")) {
-        processMergeElement(tag, currName, e);
-    } else if (tag == QStringLiteral("state")) {
+    } else if (isContainerTag(info.name)) {
+        processContainerElement(e, info.name, e.attribute(QStringLiteral("name")));
+    } else if (info.tag == MergeTag || info.tag == DefineGroupTag || info.tag == ActionListTag) {
+        processMergeElement(info.name, e.attribute(QStringLiteral("name")), e);
+    } else if (info.tag == StateTag) {
         processStateElement(e);
     }
 }
@@ -561,6 +1010,25 @@ void BuildHelper::processActionOrCustomElement(const QDomElement &e, bool isActi
 
     bool guiElementCreated = false;
     if (isActionTag) {
+        // Consecutive actions going to the same place are inserted together, see flushPendingActions.
+        // That's only possible if the merging index moves forward after each action,
+        // i.e. if it's not one of the current client's.
+        if (it == parentNode->mergingIndices.end() || (*it).clientName != m_state.clientName) {
+            QAction *action = m_state.guiClient->action(e);
+            if (action) {
+                if (!pendingActions.isEmpty() && (pendingMergingIt != it || pendingClient != containerClient)) {
+                    flushPendingActions();
+                }
+                if (pendingActions.isEmpty()) {
+                    pendingMergingIt = it;
+                    pendingIndex = idx;
+                    pendingClient = containerClient;
+                }
+                pendingActions.append(action);
+            }
+            return;
+        }
+        flushPendingActions();
         guiElementCreated = processActionElement(e, idx);
     } else {
         guiElementCreated = processCustomElement(e, idx);
@@ -598,6 +1066,37 @@ bool BuildHelper::processActionElement(const QDomElement &e, int idx)
     return true;
 }
 
+/*
+ * Plugs the actions collected by processActionOrCustomElement in one go, and adjusts
+ * the merging indices once, instead of doing both for each action.
+ */
+void BuildHelper::flushPendingActions()
+{
+    if (pendingActions.isEmpty()) {
+        return;
+    }
+
+    QWidget *container = parentNode->container;
+    QAction *before = nullptr;
+    if (pendingIndex >= 0) {
+        const QList<QAction *> containerActions = container->actions();
+        if (pendingIndex < containerActions.count()) {
+            before = containerActions.at(pendingIndex);
+        }
+    }
+
+    container->insertActions(before, pendingActions);
+
+    // save a reference to the plugged actions, in order to properly unplug them afterwards.
+    pendingClient->actions += pendingActions;
+
+    // adjust any following merging indices and the current running index for the container
+    parentNode->adjustMergingIndices(pendingActions.count(), pendingMergingIt, m_state.clientName);
+
+    pendingActions.clear();
+    pendingClient = nullptr;
+}
+
 bool BuildHelper::processCustomElement(const QDomElement &e, int idx)
 {
     assert(parentNode->builder);
@@ -625,18 +1124,18 @@ void BuildHelper::processStateElement(const QDomElement &element)
             continue;
         }
 
-        QString tagName = e.tagName().toLower();
+        const ElementTag tag = tagInfo(e.tagName()).tag;
 
-        if (tagName != QStringLiteral("enable") && tagName != QLatin1String("disable")) {
+        if (tag != EnableTag && tag != DisableTag) {
             continue;
         }
 
-        bool processingActionsToEnable = (tagName == QStringLiteral("enable"));
+        bool processingActionsToEnable = (tag == EnableTag);
 
         // process action names
         for (QDomNode n2 = n.firstChild(); !n2.isNull(); n2 = n2.nextSibling()) {
             QDomElement actionEl = n2.toElement();
-            if (actionEl.tagName().toLower() != QStringLiteral("action")) {
+            if (tagInfo(actionEl.tagName()).tag != ActionTag) {
                 continue;
             }
 
@@ -708,6 +1207,9 @@ void BuildHelper::processMergeElement(const QString &tag, const QString &name, c
     } else {
         parentNode->mergingIndices.append(newIdx);
     }
+    if (tag == tagActionList) {
+        parentNode->indexActionList(mergingName);
+    }
 
     if (mergingName == defaultMergingName) {
         ignoreDefaultMergingIndex = true;
@@ -723,9 +1225,17 @@ void BuildHelper::processMergeElement(const QString &tag, const QString &name, c
 void BuildHelper::processContainerElement(const QDomElement &e, const QString &tag,
         const QString &name)
 {
-    ContainerNode *containerNode = parentNode->findContainer(name, tag,
-                                   &containerList,
-                                   m_state.guiClient);
+    ContainerNode *containerNode;
+    Q_FOREVER {
+        containerNode = parentNode->findContainer(name, tag, &containerList, m_state.guiClient);
+        if (!containerNode || !containerNode->pendingRemoval
+                || adoptPendingContainer(containerNode, e, tag)) {
+            break;
+        }
+        // a container of the replaced client which doesn't match this element:
+        // leave it to be removed, and create a new one
+        containerList.insert(containerNode->container);
+    }
 
     if (!containerNode) {
         MergingIndexList::iterator it(m_state.currentClientMergingIt);
@@ -751,15 +1261,15 @@ void BuildHelper::processContainerElement(const QDomElement &e, const QString &t
                               [container](ContainerNode *child) { return child->container == container; })
                 == parentNode->children.constEnd());
 
-        containerList.append(container);
+        containerList.insert(container);
 
         QString mergingName;
         if (it != parentNode->mergingIndices.end()) {
             mergingName = (*it).mergingName;
         }
 
-        QStringList cusTags = m_state.builderCustomTags;
-        QStringList conTags = m_state.builderContainerTags;
+        QSet<QString> cusTags = m_state.builderCustomTags;
+        QSet<QString> conTags = m_state.builderContainerTags;
         if (builder != m_state.builder) {
             cusTags = m_state.clientBuilderCustomTags;
             conTags = m_state.clientBuilderContainerTags;
@@ -768,6 +1278,12 @@ void BuildHelper::processContainerElement(const QDomElement &e, const QString &t
         containerNode = new ContainerNode(container, tag, name, parentNode,
                                           m_state.guiClient, builder, containerAction,
                                           mergingName, group, cusTags, conTags);
+
+        // only submenus are populated lazily, not e.g. popup menus looked up by the application
+        if (m_state.lazyMenuPopulation && qobject_cast<QMenu *>(container)
+                && (qobject_cast<QMenu *>(parentNode->container) || qobject_cast<QMenuBar *>(parentNode->container))) {
+            containerNode->populated = false;
+        }
     } else {
         if (tag == QStringLiteral("toolbar")) {
             KToolBar *bar = qobject_cast<KToolBar *>(containerNode->container);
@@ -781,7 +1297,11 @@ void BuildHelper::processContainerElement(const QDomElement &e, const QString &t
         }
     }
 
-    BuildHelper(m_state, containerNode).build(e);
+    if (containerNode->populated) {
+        BuildHelper(m_state, containerNode).build(e);
+    } else {
+        containerNode->defer(m_state, e);
+    }
 
     // and re-calculate running values, for better performance
     m_state.currentDefaultMergingIt = parentNode->findIndex(QStringLiteral("<default>"));
@@ -789,10 +1309,73 @@ void BuildHelper::processContainerElement(const QDomElement &e, const QString &t
                                  m_state, ignoreDefaultMergingIndex);
 }
 
+// Whether two elements describe the same container, i.e. have the same attributes and text
+static bool sameContainerElement(const QDomElement &e1, const QDomElement &e2)
+{
+    const QDomNamedNodeMap attributes = e1.attributes();
+    if (attributes.count() != e2.attributes().count()) {
+        return false;
+    }
+    for (int i = 0; i < attributes.count(); ++i) {
+        const QDomAttr attr = attributes.item(i).toAttr();
+        if (!e2.hasAttribute(attr.name()) || e2.attribute(attr.name()) != attr.value()) {
+            return false;
+        }
+    }
+
+    const QString attrText1 = QStringLiteral("text");
+    const QString attrText2 = QStringLiteral("Text");
+    QDomElement text1 = e1.namedItem(attrText1).toElement();
+    if (text1.isNull()) {
+        text1 = e1.namedItem(attrText2).toElement();
+    }
+    QDomElement text2 = e2.namedItem(attrText1).toElement();
+    if (text2.isNull()) {
+        text2 = e2.namedItem(attrText2).toElement();
+    }
+    if (text1.isNull() || text2.isNull()) {
+        return text1.isNull() && text2.isNull();
+    }
+    return text1.text() == text2.text() && sameContainerElement(text1, text2);
+}
+
+/*
+ * Lets the client being built take over a container left by the client it replaces,
+ * if it would have created the same container anyway.
+ */
+bool BuildHelper::adoptPendingContainer(ContainerNode *node, const QDomElement &element, const QString &tag)
+{
+    KXMLGUIBuilder *builder = m_state.builder;
+    if (m_state.clientBuilder && m_state.clientBuilderContainerTags.contains(tag)) {
+        builder = m_state.clientBuilder;
+    }
+    if (node->builder != builder) {
+        return false;
+    }
+
+    KToolBar *bar = qobject_cast<KToolBar *>(node->container);
+    if (bar) {
+        // the toolbar state belongs to the client, swap it like removeContainer and createContainer would
+        bar->saveState(node->pendingElement);
+        bar->removeXMLGUIClient(node->pendingClient);
+        bar->loadState(element);
+    } else if (node->pendingElement.isNull() || !sameContainerElement(node->pendingElement, element)) {
+        return false;
+    }
+
+    node->client = m_state.guiClient;
+    node->pendingRemoval = false;
+    node->pendingClient = nullptr;
+    node->pendingElement = QDomElement();
+    return true;
+}
+
 QWidget *BuildHelper::createContainer(QWidget *parent, int index,
                                       const QDomElement &element, QAction *&containerAction,
                                       KXMLGUIBuilder **builder)
 {
+    KXmlGuiProfiler::Phase phase("createContainer");
+
     QWidget *res = nullptr;
 
     if (m_state.clientBuilder) {
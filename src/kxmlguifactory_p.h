@@ -21,8 +21,11 @@
 
 #include <QStringList>
 #include <QMap>
+#include <QHash>
+#include <QSet>
 #include <QDomElement>
 #include <QStack>
+#include <QVector>
 #include <QAction>
 #include <QDebug>
 
@@ -35,6 +38,39 @@ namespace KXMLGUI
 
 struct BuildState;
 
+/*
+ * The tags the factory itself handles, besides the container and custom tags of the builders.
+ */
+enum ElementTag {
+    OtherTag,
+    ActionTag,
+    MergeTag,
+    DefineGroupTag,
+    ActionListTag,
+    StateTag,
+    EnableTag,
+    DisableTag
+};
+
+struct TagInfo {
+    QString name; // in lower case
+    ElementTag tag;
+};
+
+/*
+ * Tag names are case insensitive. This returns the lower case name of @p tagName and what it
+ * stands for, from a cache so that building the GUI doesn't create a new string for every element.
+ * Only to be used from the GUI thread.
+ */
+TagInfo tagInfo(const QString &tagName);
+
+/*
+ * Changes whenever the document or the build document of @p client is set (which includes
+ * merging into it), so that the factory can tell whether what it derived from the document
+ * of a client is still up to date. Only to be used from the GUI thread.
+ */
+quint64 documentRevision(const KXMLGUIClient *client);
+
 class ActionList : public QList<QAction *>
 {
 public:
@@ -76,6 +112,9 @@ struct ContainerClient {
 typedef QList<ContainerClient *> ContainerClientList;
 
 struct ContainerNode;
+typedef QList<ContainerNode *> ContainerNodeList;
+
+struct PendingBuild;
 
 struct MergingIndex {
     int value; // the actual index value, used as index for plug() or createContainer() calls
@@ -92,8 +131,8 @@ typedef QVector<MergingIndex> MergingIndexList;
  *
  * The builder variable is needed for using the proper GUIBuilder for destruction ( to use the same for
  * con- and destruction ). The builderCustomTags and builderContainerTags variables are cached values
- * of what the corresponding methods of the GUIBuilder which built the container return. The stringlists
- * is shared all over the place, so there's no need to worry about memory consumption for these
+ * of what the corresponding methods of the GUIBuilder which built the container return. The sets
+ * are shared all over the place, so there's no need to worry about memory consumption for these
  * variables :-)
  *
  * The mergingIndices list contains the merging indices ;-) , as defined by <Merge>, <DefineGroup>
@@ -110,15 +149,15 @@ struct ContainerNode {
                   KXMLGUIBuilder *_builder = nullptr, QAction *containerAction = nullptr,
                   const QString &_mergingName = QString(),
                   const QString &groupName = QString(),
-                  const QStringList &customTags = QStringList(),
-                  const QStringList &containerTags = QStringList());
+                  const QSet<QString> &customTags = QSet<QString>(),
+                  const QSet<QString> &containerTags = QSet<QString>());
     ~ContainerNode();
 
     ContainerNode *parent;
     KXMLGUIClient *client;
     KXMLGUIBuilder *builder;
-    QStringList builderCustomTags;
-    QStringList builderContainerTags;
+    QSet<QString> builderCustomTags;
+    QSet<QString> builderContainerTags;
     QWidget *container;
     QAction *containerAction;
 
@@ -130,15 +169,57 @@ struct ContainerNode {
     ContainerClientList clients;
     QList<ContainerNode *> children;
 
+    /*
+     * Lookup tables, kept in the same order as clients and children.
+     * nodesByName, nodesByTag and nodesByActionList cover the whole tree and are only maintained
+     * in the root node (nodes without name aren't in nodesByName). nodesByActionList maps the
+     * merging name of an <ActionList> ("actionlist" + name) to the nodes defining it.
+     */
+    QHash<KXMLGUIClient *, ContainerClientList> clientsByGuiClient;
+    QHash<QString, ContainerNodeList> childrenByName;
+    QHash<QString, ContainerNodeList> childrenByTag;
+    QHash<QString, ContainerNodeList> nodesByName;
+    QHash<QString, ContainerNodeList> nodesByTag;
+    QHash<QString, ContainerNodeList> nodesByActionList;
+
     int index;
     MergingIndexList mergingIndices;
 
     QString mergingName;
 
+    /*
+     * While replacing a client (see KXMLGUIFactory::replaceClient), containers of the old
+     * client are not removed right away: they are kept around (without owner) in case the
+     * new client defines the same container, and only removed once it has been built.
+     */
+    bool pendingRemoval;
+    KXMLGUIClient *pendingClient; // the previous owner
+    QDomElement pendingElement; // in the previous owner's build document
+
+    /*
+     * With lazy menu population (see KXMLGUIFactory::setLazyMenuPopulation), the contents
+     * of submenus are only built when the menu is about to be shown for the first time.
+     * Until then the clients' elements for this container are kept in pendingBuilds.
+     * The root node keeps the nodes with pending builds in pendingNodes.
+     */
+    bool populated;
+    QList<PendingBuild *> pendingBuilds;
+    QMetaObject::Connection populateConnection;
+    ContainerNodeList pendingNodes;
+
+    void defer(const BuildState &state, const QDomElement &element);
+    void populate();
+    bool populatePending(KXMLGUIClient *client);
+    void populateActionList(KXMLGUIClient *client, const QString &actionListName);
+    bool hasPendingBuilds(KXMLGUIClient *client) const;
+    bool hasPendingActionList(KXMLGUIClient *client, const QString &actionListName) const;
+
     void clearChildren()
     {
         qDeleteAll(children);
         children.clear();
+        childrenByName.clear();
+        childrenByTag.clear();
     }
     void removeChild(ContainerNode *child);
     void deleteChild(ContainerNode *child);
@@ -147,18 +228,22 @@ struct ContainerNode {
     MergingIndexList::iterator findIndex(const QString &name);
     ContainerNode *findContainer(const QString &_name, bool tag);
     ContainerNode *findContainer(const QString &name, const QString &tagName,
-                                 const QList<QWidget *> *excludeList,
+                                 const QSet<QWidget *> *excludeList,
                                  KXMLGUIClient *currClient);
+    ContainerNodeList nodesNamed(const QString &name, bool tag) const;
 
     ContainerClient *findChildContainerClient(KXMLGUIClient *currentGUIClient,
             const QString &groupName,
             const MergingIndexList::iterator &mergingIdx);
 
-    void plugActionList(BuildState &state);
-    void plugActionList(BuildState &state, const MergingIndexList::iterator &mergingIdxIt);
+    void indexActionList(const QString &mergingName);
+    void unindexActionList(const QString &mergingName);
+    ContainerNodeList actionListNodes(const QString &actionListName);
 
-    void unplugActionList(BuildState &state);
+    void plugActionList(BuildState &state, const MergingIndexList::iterator &mergingIdxIt);
     void unplugActionList(BuildState &state, const MergingIndexList::iterator &mergingIdxIt);
+    void replaceActionList(BuildState &state, const MergingIndexList::iterator &mergingIdxIt,
+                           QSet<QAction *> &previousActions);
 
     void adjustMergingIndices(int offset, const MergingIndexList::iterator &it, const QString &currentClientName);
 
@@ -169,6 +254,9 @@ struct ContainerNode {
     void unplugActions(BuildState &state);
     void unplugClient(ContainerClient *client);
 
+    bool hasActiveChildren() const;
+    void removePendingChildren();
+
     void reset();
 
     int calcMergingIndex(const QString &mergingName,
@@ -177,9 +265,11 @@ struct ContainerNode {
                          bool ignoreDefaultMergingIndex);
 
     void dump(int offset = 0);
-};
 
-typedef QList<ContainerNode *> ContainerNodeList;
+private:
+    ContainerNode *rootNode();
+    void unindexChild(ContainerNode *child);
+};
 
 class BuildHelper
 {
@@ -195,6 +285,7 @@ private:
     void processActionOrCustomElement(const QDomElement &e, bool isActionTag);
     bool processActionElement(const QDomElement &e, int idx);
     bool processCustomElement(const QDomElement &e, int idx);
+    void flushPendingActions();
 
     void processStateElement(const QDomElement &element);
 
@@ -202,16 +293,17 @@ private:
 
     void processContainerElement(const QDomElement &e, const QString &tag,
                                  const QString &name);
+    bool adoptPendingContainer(ContainerNode *node, const QDomElement &element, const QString &tag);
 
     QWidget *createContainer(QWidget *parent, int index, const QDomElement &element,
                              QAction *&containerAction, KXMLGUIBuilder **builder);
 
     int calcMergingIndex(const QDomElement &element, MergingIndexList::iterator &it, QString &group);
 
-    QStringList customTags;
-    QStringList containerTags;
+    bool isCustomTag(const QString &tag) const;
+    bool isContainerTag(const QString &tag) const;
 
-    QList<QWidget *> containerList;
+    QSet<QWidget *> containerList;
 
     ContainerClient *containerClient;
 
@@ -220,10 +312,17 @@ private:
     BuildState &m_state;
 
     ContainerNode *parentNode;
+
+    // actions waiting to be inserted at the same position, see flushPendingActions
+    QList<QAction *> pendingActions;
+    MergingIndexList::iterator pendingMergingIt;
+    int pendingIndex;
+    ContainerClient *pendingClient;
 };
 
 struct BuildState {
-    BuildState() : guiClient(nullptr), builder(nullptr), clientBuilder(nullptr) {}
+    BuildState() : guiClient(nullptr), builder(nullptr), clientBuilder(nullptr), keepContainers(false),
+        lazyMenuPopulation(false) {}
 
     void reset();
 
@@ -238,12 +337,31 @@ struct BuildState {
     MergingIndexList::iterator currentClientMergingIt;
 
     KXMLGUIBuilder *builder;
-    QStringList builderCustomTags;
-    QStringList builderContainerTags;
+    QSet<QString> builderCustomTags;
+    QSet<QString> builderContainerTags;
 
     KXMLGUIBuilder *clientBuilder;
-    QStringList clientBuilderCustomTags;
-    QStringList clientBuilderContainerTags;
+    QSet<QString> clientBuilderCustomTags;
+    QSet<QString> clientBuilderContainerTags;
+
+    // containers which would be removed are kept as pending instead (not cleared by reset())
+    bool keepContainers;
+
+    // see KXMLGUIFactory::setLazyMenuPopulation (not cleared by reset())
+    bool lazyMenuPopulation;
+};
+
+struct PendingBuild {
+    PendingBuild() : actionListsFound(false) {}
+
+    BuildState state;
+    QDomElement element;
+
+    bool hasActionList(const QString &name);
+
+    // the names of the <ActionList>s in element, looked up when first needed
+    QSet<QString> actionLists;
+    bool actionListsFound;
 };
 
 typedef QStack<BuildState> BuildStateStack;
@@ -0,0 +1,173 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "kxmlguifileindex_p.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStandardPaths>
+
+Q_GLOBAL_STATIC(KXmlGuiFileIndex, s_fileIndex)
+
+// How long the index is trusted before a directory is checked for changes again
+static const qint64 s_recheckInterval = 1000; // ms
+
+KXmlGuiFileIndex::KXmlGuiFileIndex()
+    : m_dataDirsChecked(0)
+{
+    m_clock.start();
+}
+
+KXmlGuiFileIndex *KXmlGuiFileIndex::self()
+{
+    return s_fileIndex();
+}
+
+QStringList KXmlGuiFileIndex::locateAll(const QString &relativePath)
+{
+    return lookup(relativePath, true);
+}
+
+QString KXmlGuiFileIndex::locate(const QString &relativePath)
+{
+    return lookup(relativePath, false).value(0);
+}
+
+void KXmlGuiFileIndex::invalidate()
+{
+    QMutexLocker locker(&m_mutex);
+    m_dataDirs.clear();
+    m_listings.clear();
+}
+
+QStringList KXmlGuiFileIndex::lookup(const QString &relativePath, bool all)
+{
+    // listing whole data directories for the compatibility locations costs more than it saves
+    if (!relativePath.startsWith(QLatin1String("kxmlgui5/"))) {
+        if (all) {
+            return QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, relativePath);
+        }
+        const QString path = QStandardPaths::locate(QStandardPaths::GenericDataLocation, relativePath);
+        return path.isEmpty() ? QStringList() : QStringList(path);
+    }
+
+    QMutexLocker locker(&m_mutex);
+    update();
+
+    QStringList result;
+    Q_FOREACH (const QString &dataDir, m_dataDirs) {
+        const QString path = dataDir + QLatin1Char('/') + relativePath;
+        const int slash = path.lastIndexOf(QLatin1Char('/'));
+        if (containsFile(path.left(slash), path.mid(slash + 1))) {
+            result.append(path);
+            if (!all) {
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+bool KXmlGuiFileIndex::isDue(qint64 checked) const
+{
+    return m_clock.elapsed() - checked >= s_recheckInterval;
+}
+
+void KXmlGuiFileIndex::update()
+{
+    if (!m_dataDirs.isEmpty() && !isDue(m_dataDirsChecked)) {
+        return;
+    }
+    const QStringList dataDirs = QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation);
+    m_dataDirsChecked = m_clock.elapsed();
+    if (dataDirs == m_dataDirs && !m_dataDirs.isEmpty()) {
+        return;
+    }
+
+    m_dataDirs = dataDirs;
+    m_listings.clear();
+
+    Q_FOREACH (const QString &dataDir, m_dataDirs) {
+        QSet<QString> visited;
+        scanDirectory(dataDir + QLatin1String("/kxmlgui5"), visited);
+    }
+}
+
+// Indexes the files in dir and all its subdirectories
+void KXmlGuiFileIndex::scanDirectory(const QString &dir, QSet<QString> &visited)
+{
+    const QFileInfo dirInfo(dir);
+    const QString canonicalPath = dirInfo.canonicalFilePath();
+    if (canonicalPath.isEmpty()) {
+        return;
+    }
+    // don't loop forever because of symlinks
+    const bool recurse = !visited.contains(canonicalPath);
+    visited.insert(canonicalPath);
+
+    Listing listing;
+    listing.modified = dirInfo.lastModified();
+    listing.checked = m_clock.elapsed();
+    QDirIterator it(dir, QDir::Files | QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        if (!info.isDir()) {
+            listing.files.insert(info.fileName());
+        } else if (recurse) {
+            scanDirectory(info.filePath(), visited);
+        }
+    }
+    m_listings.insert(dir, listing);
+}
+
+// The modification time is taken before listing, so that a change in between lists it again next time
+KXmlGuiFileIndex::Listing KXmlGuiFileIndex::listDirectory(const QFileInfo &dirInfo) const
+{
+    Listing listing;
+    listing.checked = m_clock.elapsed();
+    if (dirInfo.isDir()) {
+        listing.modified = dirInfo.lastModified();
+        QDirIterator it(dirInfo.filePath(), QDir::Files | QDir::Hidden);
+        while (it.hasNext()) {
+            it.next();
+            listing.files.insert(it.fileName());
+        }
+    }
+    return listing;
+}
+
+bool KXmlGuiFileIndex::containsFile(const QString &dir, const QString &fileName)
+{
+    QHash<QString, Listing>::iterator it = m_listings.find(dir);
+    if (it == m_listings.end()) {
+        it = m_listings.insert(dir, listDirectory(QFileInfo(dir)));
+    } else if (isDue(it->checked)) {
+        // files might have been created or deleted since
+        const QFileInfo dirInfo(dir);
+        const QDateTime modified = dirInfo.isDir() ? dirInfo.lastModified() : QDateTime();
+        if (modified != it->modified) {
+            *it = listDirectory(dirInfo);
+        } else {
+            it->checked = m_clock.elapsed();
+        }
+    }
+    return it->files.contains(fileName);
+}
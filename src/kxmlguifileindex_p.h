@@ -0,0 +1,91 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef KXMLGUIFILEINDEX_P_H
+#define KXMLGUIFILEINDEX_P_H
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+
+/**
+ * @internal
+ * Process-wide index of the files in the kxmlgui5/ directories of the generic data directories,
+ * used to locate xmlgui files.
+ *
+ * QStandardPaths::locate and locateAll check for the file in every data directory (XDG_DATA_DIRS),
+ * i.e. one stat per directory and lookup, and every client looks up its file in several places.
+ * Instead, the kxmlgui5/ directory of every data directory is scanned once. Lookups elsewhere
+ * (the compatibility locations) go to QStandardPaths, rather than listing whole data directories.
+ *
+ * The index is trusted for a while: a directory is checked again (one stat) when it's looked up
+ * more than a second after it was last checked, and listed again if its modification time changed,
+ * so that files created by other processes are found eventually. The list of data directories is
+ * checked as often. Files created or deleted by KXMLGUI itself invalidate the index right away
+ * (see invalidate()).
+ *
+ * Thread-safe, since it's used when preloading xmlgui files as well.
+ */
+class KXmlGuiFileIndex
+{
+public:
+    KXmlGuiFileIndex();
+
+    static KXmlGuiFileIndex *self();
+
+    /**
+     * Same as QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, @p relativePath)
+     */
+    QStringList locateAll(const QString &relativePath);
+
+    /**
+     * Same as QStandardPaths::locate(QStandardPaths::GenericDataLocation, @p relativePath)
+     */
+    QString locate(const QString &relativePath);
+
+    /**
+     * Forgets everything, the directories are scanned again when needed.
+     */
+    void invalidate();
+
+private:
+    QStringList lookup(const QString &relativePath, bool all);
+    void update();
+    void scanDirectory(const QString &dir, QSet<QString> &visited);
+    bool containsFile(const QString &dir, const QString &fileName);
+    bool isDue(qint64 checked) const;
+
+    struct Listing {
+        QDateTime modified; // of the directory, invalid if it doesn't exist
+        qint64 checked; // when modified was read, see m_clock
+        QSet<QString> files;
+    };
+    Listing listDirectory(const QFileInfo &dirInfo) const;
+
+    QMutex m_mutex;
+    QElapsedTimer m_clock;
+    QStringList m_dataDirs;
+    qint64 m_dataDirsChecked;
+    QHash<QString, Listing> m_listings; // directory -> the files in it
+};
+
+#endif /* KXMLGUIFILEINDEX_P_H */
@@ -0,0 +1,212 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "kxmlguiloader_p.h"
+
+#include <QDomDocument>
+#include <QXmlStreamReader>
+
+static bool isWhitespace(const QString &text)
+{
+    const QChar *c = text.constData();
+    const QChar *end = c + text.size();
+    for (; c != end; ++c) {
+        if (!c->isSpace()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static QString nullIfEmpty(const QStringRef &str)
+{
+    return str.isEmpty() ? QString() : str.toString();
+}
+
+static void propagateDomain(const QDomElement &parent, const QString &domain,
+                            const QStringList &textTagNames, const QString &attrDomain)
+{
+    for (QDomElement e = parent.firstChildElement(); !e.isNull(); e = e.nextSiblingElement()) {
+        if (textTagNames.contains(e.tagName()) && e.attribute(attrDomain).isEmpty()) {
+            e.setAttribute(attrDomain, domain);
+        }
+        propagateDomain(e, domain, textTagNames, attrDomain);
+    }
+}
+
+void KXmlGuiLoader::propagateTranslationDomain(QDomDocument &doc, const QString &defaultDomain,
+                                               const QStringList &textTagNames)
+{
+    const QString attrDomain = QStringLiteral("translationDomain");
+    const QDomElement root = doc.documentElement();
+    QString domain = root.attribute(attrDomain);
+    if (domain.isEmpty()) {
+        domain = defaultDomain;
+    }
+    if (!domain.isEmpty()) {
+        propagateDomain(root, domain, textTagNames, attrDomain);
+    }
+}
+
+bool KXmlGuiLoader::load(const QByteArray &data, QDomDocument &doc,
+                         const QString &defaultDomain, const QStringList &textTagNames,
+                         Error *error)
+{
+    QXmlStreamReader reader(data);
+    return load(reader, doc, defaultDomain, textTagNames, error);
+}
+
+bool KXmlGuiLoader::load(const QString &data, QDomDocument &doc,
+                         const QString &defaultDomain, const QStringList &textTagNames,
+                         Error *error)
+{
+    QXmlStreamReader reader(data);
+    return load(reader, doc, defaultDomain, textTagNames, error);
+}
+
+bool KXmlGuiLoader::load(QXmlStreamReader &reader, QDomDocument &doc,
+                         const QString &defaultDomain, const QStringList &textTagNames,
+                         Error *error)
+{
+    // like QDomDocument::setContent(QString), which doesn't process namespaces either
+    reader.setNamespaceProcessing(false);
+
+    const QString attrDomain = QStringLiteral("translationDomain");
+
+    QDomDocument result;
+    QDomNode parent = result;
+    QString domain;
+    bool haveDocumentElement = false;
+
+    // Character data is collected until the next markup, since it can be reported in several
+    // pieces. Text consisting only of whitespace (i.e. indentation) is dropped, like QDomDocument does.
+    QString text;
+    auto flushText = [&]() {
+        if (!text.isEmpty()) {
+            if (!isWhitespace(text)) {
+                parent.appendChild(result.createTextNode(text));
+            }
+            text.resize(0);
+        }
+    };
+
+    while (!reader.atEnd()) {
+        switch (reader.readNext()) {
+        case QXmlStreamReader::StartElement: {
+            flushText();
+            QDomElement element = result.createElement(reader.qualifiedName().toString());
+            const QXmlStreamAttributes attributes = reader.attributes();
+            for (int i = 0; i < attributes.size(); ++i) {
+                const QXmlStreamAttribute &attr = attributes.at(i);
+                element.setAttribute(attr.qualifiedName().toString(), attr.value().toString());
+            }
+
+            if (!haveDocumentElement) {
+                // The top document element may have translation domain attribute set,
+                // or the translation domain may be implicitly the application domain.
+                // This domain must be used to fetch translations for all text elements
+                // in the document that do not have their own domain attribute.
+                // In order to preserve this semantics through document mergings,
+                // the top or application domain must be propagated to all text elements
+                // lacking their own domain attribute.
+                haveDocumentElement = true;
+                domain = element.attribute(attrDomain);
+                if (domain.isEmpty()) {
+                    domain = defaultDomain;
+                }
+            } else if (!domain.isEmpty() && textTagNames.contains(element.tagName())
+                       && element.attribute(attrDomain).isEmpty()) {
+                element.setAttribute(attrDomain, domain);
+            }
+
+            parent = parent.appendChild(element);
+            break;
+        }
+        case QXmlStreamReader::EndElement:
+            flushText();
+            parent = parent.parentNode();
+            break;
+        case QXmlStreamReader::Characters:
+            if (reader.isCDATA()) {
+                flushText();
+                parent.appendChild(result.createCDATASection(reader.text().toString()));
+            } else {
+                text += reader.text();
+            }
+            break;
+        case QXmlStreamReader::Comment:
+            flushText();
+            parent.appendChild(result.createComment(reader.text().toString()));
+            break;
+        case QXmlStreamReader::ProcessingInstruction:
+            flushText();
+            parent.appendChild(result.createProcessingInstruction(reader.processingInstructionTarget().toString(),
+                                                                  reader.processingInstructionData().toString()));
+            break;
+        case QXmlStreamReader::EntityReference:
+            flushText();
+            parent.appendChild(result.createEntityReference(reader.name().toString()));
+            break;
+        case QXmlStreamReader::StartDocument:
+            // QDomDocument keeps the XML declaration as a processing instruction
+            if (!reader.documentVersion().isEmpty()) {
+                QString declaration = QStringLiteral("version='");
+                declaration += reader.documentVersion();
+                declaration += QLatin1Char('\'');
+                if (!reader.documentEncoding().isEmpty()) {
+                    declaration += QLatin1String(" encoding='");
+                    declaration += reader.documentEncoding();
+                    declaration += QLatin1Char('\'');
+                }
+                if (reader.isStandaloneDocument()) {
+                    declaration += QLatin1String(" standalone='yes'");
+                }
+                result.appendChild(result.createProcessingInstruction(QStringLiteral("xml"), declaration));
+            }
+            break;
+        case QXmlStreamReader::DTD: {
+            // The document type can only be set when creating the document,
+            // so move over what was before it (the XML declaration, comments)
+            const QDomDocumentType docType = QDomImplementation().createDocumentType(reader.dtdName().toString(),
+                                                                                   nullIfEmpty(reader.dtdPublicId()),
+                                                                                   nullIfEmpty(reader.dtdSystemId()));
+            QDomDocument withDocType(docType);
+            for (QDomNode n = result.firstChild(); !n.isNull(); n = n.nextSibling()) {
+                withDocType.appendChild(withDocType.importNode(n, true));
+            }
+            result = withDocType;
+            parent = result;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    if (reader.hasError()) {
+        if (error) {
+            error->message = reader.errorString();
+            error->line = reader.lineNumber();
+            error->column = reader.columnNumber();
+        }
+        return false;
+    }
+
+    doc = result;
+    return true;
+}
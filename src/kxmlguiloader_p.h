@@ -0,0 +1,75 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef KXMLGUILOADER_P_H
+#define KXMLGUILOADER_P_H
+
+#include <QStringList>
+
+class QDomDocument;
+class QXmlStreamReader;
+
+/**
+ * @internal
+ * Helper for KXMLGUIClient::setXML and setXMLFile.
+ *
+ * Builds a QDomDocument from an xmlgui file in a single pass with QXmlStreamReader,
+ * reading UTF-8 data directly instead of decoding the whole file into a QString first.
+ * The resulting document is the same as the one created by QDomDocument::setContent
+ * (without namespace processing, i.e. whitespace-only text is dropped).
+ *
+ * While parsing, the translation domain of the document is stored into every text
+ * element (see @p textTagNames) which doesn't have its own translationDomain attribute,
+ * so that it survives the merging of documents.
+ */
+class KXmlGuiLoader
+{
+public:
+    struct Error {
+        Error() : line(0), column(0) {}
+        QString message;
+        int line;
+        int column;
+    };
+
+    /**
+     * @param defaultDomain the domain to use if the document element has no
+     * translationDomain attribute, usually the application domain
+     * @return false on parse error, in which case @p doc is left untouched
+     */
+    static bool load(const QByteArray &data, QDomDocument &doc,
+                     const QString &defaultDomain, const QStringList &textTagNames,
+                     Error *error = nullptr);
+    static bool load(const QString &data, QDomDocument &doc,
+                     const QString &defaultDomain, const QStringList &textTagNames,
+                     Error *error = nullptr);
+
+    /**
+     * Stores the translation domain of @p doc into its text elements, like load() does,
+     * for documents which were built in some other way.
+     */
+    static void propagateTranslationDomain(QDomDocument &doc, const QString &defaultDomain,
+                                           const QStringList &textTagNames);
+
+private:
+    static bool load(QXmlStreamReader &reader, QDomDocument &doc,
+                     const QString &defaultDomain, const QStringList &textTagNames,
+                     Error *error);
+};
+
+#endif /* KXMLGUILOADER_P_H */
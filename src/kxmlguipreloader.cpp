@@ -0,0 +1,209 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "kxmlguipreloader_p.h"
+
+#include "kxmlguifileindex_p.h"
+#include "kxmlguiloader_p.h"
+#include "kxmlguiprofiler_p.h"
+#include "kxmlguiversionhandler_p.h"
+#include "debug.h"
+
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QRunnable>
+
+Q_GLOBAL_STATIC(KXmlGuiPreloader, s_preloader)
+
+static QString entryKey(const QString &file, const QString &componentName)
+{
+    return componentName + QLatin1Char('\n') + file;
+}
+
+class KXmlGuiPreloadJob : public QRunnable
+{
+public:
+    KXmlGuiPreloadJob(KXmlGuiPreloader *preloader, quint64 id, const QString &file, const QString &componentName,
+                      const QString &domain, const QStringList &textTagNames)
+        : m_preloader(preloader), m_id(id), m_file(file), m_componentName(componentName),
+          m_domain(domain), m_textTagNames(textTagNames)
+    {
+    }
+
+    void run() override
+    {
+        const QStringList files = KXmlGuiPreloader::locateXmlFiles(m_file, m_componentName);
+
+        QByteArray data;
+        QDomDocument document;
+        if (!files.isEmpty()) {
+            KXmlGuiVersionHandler versionHandler(files);
+            document = versionHandler.mergedDocument();
+            if (!document.isNull()) {
+                KXmlGuiLoader::propagateTranslationDomain(document, m_domain, m_textTagNames);
+            } else {
+                data = versionHandler.finalDocumentData();
+            }
+        }
+
+        // like KXMLGUIClient::setXMLFile, no document at all is fine
+        const bool ok = data.isEmpty() || KXmlGuiLoader::load(data, document, m_domain, m_textTagNames);
+
+        m_preloader->finish(m_id, entryKey(m_file, m_componentName), files, document, ok);
+    }
+
+private:
+    KXmlGuiPreloader *const m_preloader;
+    const quint64 m_id;
+    const QString m_file;
+    const QString m_componentName;
+    const QString m_domain;
+    const QStringList m_textTagNames;
+};
+
+KXmlGuiPreloader::KXmlGuiPreloader()
+    : m_nextId(1)
+{
+}
+
+KXmlGuiPreloader::~KXmlGuiPreloader()
+{
+    m_pool.waitForDone();
+}
+
+KXmlGuiPreloader *KXmlGuiPreloader::self()
+{
+    return s_preloader();
+}
+
+void KXmlGuiPreloader::preload(const QString &file, const QString &componentName,
+                               const QString &domain, const QStringList &textTagNames)
+{
+    quint64 id;
+    {
+        QMutexLocker locker(&m_mutex);
+        id = m_nextId++;
+        Entry &entry = m_entries[entryKey(file, componentName)];
+        entry = Entry();
+        entry.id = id;
+        entry.componentName = componentName;
+        entry.domain = domain;
+        entry.textTagNames = textTagNames;
+    }
+    m_pool.start(new KXmlGuiPreloadJob(this, id, file, componentName, domain, textTagNames));
+}
+
+bool KXmlGuiPreloader::take(const QString &file, const QString &componentName,
+                            const QString &domain, const QStringList &textTagNames,
+                            QDomDocument &document, QStringList &files)
+{
+    const QString key = entryKey(file, componentName);
+
+    QMutexLocker locker(&m_mutex);
+    QHash<QString, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return false;
+    }
+
+    const quint64 id = it->id;
+    while (!it->done) {
+        m_finished.wait(&m_mutex);
+        it = m_entries.find(key);
+        if (it == m_entries.end() || it->id != id) { // invalidated meanwhile
+            return false;
+        }
+    }
+
+    const Entry entry = it.value();
+    m_entries.erase(it);
+
+    if (!entry.ok || entry.domain != domain || entry.textTagNames != textTagNames) {
+        return false;
+    }
+    document = entry.document;
+    files = entry.files;
+    return true;
+}
+
+void KXmlGuiPreloader::invalidate(const QString &componentName)
+{
+    QMutexLocker locker(&m_mutex);
+    QHash<QString, Entry>::iterator it = m_entries.begin();
+    while (it != m_entries.end()) {
+        if (it->componentName == componentName) {
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_finished.wakeAll();
+}
+
+void KXmlGuiPreloader::finish(quint64 id, const QString &key, const QStringList &files,
+                              const QDomDocument &document, bool ok)
+{
+    QMutexLocker locker(&m_mutex);
+    QHash<QString, Entry>::iterator it = m_entries.find(key);
+    if (it != m_entries.end() && it->id == id) {
+        it->done = true;
+        it->ok = ok;
+        it->files = files;
+        it->document = document;
+    }
+    m_finished.wakeAll();
+}
+
+QStringList KXmlGuiPreloader::locateXmlFiles(const QString &file, const QString &componentName)
+{
+    KXmlGuiProfiler::Phase phase("locateFiles");
+
+    QStringList allFiles;
+    if (!QDir::isRelativePath(file)) {
+        allFiles.append(file);
+    } else {
+        const QString filter = componentName + QLatin1Char('/') + file;
+
+        KXmlGuiFileIndex *index = KXmlGuiFileIndex::self();
+
+        // files on filesystem
+        allFiles << index->locateAll(QStringLiteral("kxmlgui5/") + filter); // KF >= 5.1
+
+        // KF >= 5.4 (resource file)
+        const QString qrcFile(QStringLiteral(":/kxmlgui5/") + filter);
+        if (QFile::exists(qrcFile)) {
+            allFiles << qrcFile;
+        }
+
+        // then compat locations
+        const QStringList compatFiles =
+                   index->locateAll(filter) + // kdelibs4, KF 5.0
+                   index->locateAll(file); // kdelibs4, KF 5.0, caller passes component name
+
+        if (allFiles.isEmpty() && !compatFiles.isEmpty()) {
+            qCWarning(DEBUG_KXMLGUI) << "KXMLGUI file found at deprecated location" << compatFiles << "-- please use ${KXMLGUI_INSTALL_DIR} to install this file instead.";
+        }
+        allFiles += compatFiles;
+    }
+    if (allFiles.isEmpty() && !file.isEmpty()) {
+        // if a non-empty file gets passed and we can't find it,
+        // inform the developer using some debug output
+        qCWarning(DEBUG_KXMLGUI) << "cannot find .rc file" << file << "for component" << componentName;
+    }
+    return allFiles;
+}
@@ -0,0 +1,93 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef KXMLGUIPRELOADER_P_H
+#define KXMLGUIPRELOADER_P_H
+
+#include <QDomDocument>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+/**
+ * @internal
+ * Implementation of KXMLGUIClient::preloadXMLFile.
+ *
+ * Locating the candidate files of an xmlgui file, picking the most recent version and
+ * parsing it doesn't need the GUI thread, so it's done in a thread pool. The resulting
+ * documents are kept until KXMLGUIClient::setXMLFile asks for them (once), which waits
+ * for the preloading to finish if needed.
+ */
+class KXmlGuiPreloader
+{
+public:
+    KXmlGuiPreloader();
+    ~KXmlGuiPreloader();
+
+    static KXmlGuiPreloader *self();
+
+    void preload(const QString &file, const QString &componentName,
+                 const QString &domain, const QStringList &textTagNames);
+
+    /**
+     * Takes the preloaded document of @p file, waiting for it if it's still being loaded.
+     * @param files set to the candidate files the document was built from
+     * @return false if @p file wasn't preloaded (with the same parameters) or couldn't be parsed
+     */
+    bool take(const QString &file, const QString &componentName,
+              const QString &domain, const QStringList &textTagNames,
+              QDomDocument &document, QStringList &files);
+
+    /**
+     * Forgets the preloaded documents of @p componentName, e.g. after saving a local xml file.
+     */
+    void invalidate(const QString &componentName);
+
+    /**
+     * Returns the candidate files for the xmlgui file @p file of the component @p componentName,
+     * see KXMLGUIClient::setXMLFile.
+     */
+    static QStringList locateXmlFiles(const QString &file, const QString &componentName);
+
+private:
+    struct Entry {
+        Entry() : id(0), done(false), ok(false) {}
+        quint64 id;
+        bool done;
+        bool ok;
+        QString componentName;
+        QString domain;
+        QStringList textTagNames;
+        QStringList files;
+        QDomDocument document;
+    };
+
+    friend class KXmlGuiPreloadJob;
+    void finish(quint64 id, const QString &key, const QStringList &files,
+                const QDomDocument &document, bool ok);
+
+    QMutex m_mutex;
+    QWaitCondition m_finished;
+    QHash<QString, Entry> m_entries;
+    quint64 m_nextId;
+    QThreadPool m_pool;
+};
+
+#endif /* KXMLGUIPRELOADER_P_H */
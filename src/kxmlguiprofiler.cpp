@@ -0,0 +1,246 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "kxmlguiprofiler_p.h"
+
+#include "kxmlguiclient.h"
+#include "debug.h"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QStringList>
+#include <QThread>
+#include <QThreadStorage>
+#include <QVector>
+
+// debug output is off by default, enable with QT_LOGGING_RULES="kf5.kxmlgui.profile.debug=true"
+Q_LOGGING_CATEGORY(DEBUG_KXMLGUI_PROFILE, "kf5.kxmlgui.profile", QtInfoMsg)
+
+namespace
+{
+
+struct TraceEvent {
+    const char *name;
+    QString client;
+    qint64 start; // ns since the profiler was first used
+    qint64 duration; // ns
+    quintptr thread;
+};
+
+// The recorded phases of all threads, and the trace file they get written to at exit
+class Trace
+{
+public:
+    Trace()
+        : fileName(QFile::decodeName(qgetenv("KXMLGUI_TRACE_FILE")))
+    {
+        clock.start();
+    }
+
+    ~Trace()
+    {
+        if (fileName.isEmpty()) {
+            return;
+        }
+        QFile file(fileName);
+        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            file.write(json());
+        } else {
+            qCWarning(DEBUG_KXMLGUI) << "Cannot write the xmlgui trace to" << fileName;
+        }
+    }
+
+    QByteArray json()
+    {
+        const qint64 pid = QCoreApplication::applicationPid();
+        QJsonArray events;
+        QMutexLocker locker(&mutex);
+        Q_FOREACH (const TraceEvent &event, this->events) {
+            QJsonObject args;
+            args.insert(QStringLiteral("client"), event.client);
+            QJsonObject object;
+            object.insert(QStringLiteral("name"), QString::fromLatin1(event.name));
+            object.insert(QStringLiteral("cat"), QStringLiteral("kxmlgui"));
+            object.insert(QStringLiteral("ph"), QStringLiteral("X"));
+            object.insert(QStringLiteral("ts"), event.start / 1000.0); // in µs
+            object.insert(QStringLiteral("dur"), event.duration / 1000.0);
+            object.insert(QStringLiteral("pid"), pid);
+            object.insert(QStringLiteral("tid"), qint64(event.thread));
+            object.insert(QStringLiteral("args"), args);
+            events.append(object);
+        }
+        QJsonObject root;
+        root.insert(QStringLiteral("traceEvents"), events);
+        root.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+        return QJsonDocument(root).toJson(QJsonDocument::Compact);
+    }
+
+    QElapsedTimer clock;
+    const QString fileName;
+    QMutex mutex;
+    QVector<TraceEvent> events;
+};
+
+// The phases of one thread which haven't ended yet, and those which ended
+// since the outermost one began, for the summary
+struct ThreadState {
+    struct Open {
+        const char *name;
+        QString client;
+    };
+    QVector<Open> open;
+    QVector<TraceEvent> ended;
+};
+
+}
+
+Q_GLOBAL_STATIC(Trace, s_trace)
+static QThreadStorage<ThreadState *> s_threadStates;
+
+// Phases also run in the threads of the preloader, hence atomics.
+// -1 until checked, then 0 or 1
+static QBasicAtomicInt s_enabled = Q_BASIC_ATOMIC_INITIALIZER(-1);
+static QBasicAtomicInt s_recordAlways = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+bool KXmlGuiProfiler::isEnabled()
+{
+    int enabled = s_enabled.loadAcquire();
+    if (enabled < 0) {
+        enabled = (DEBUG_KXMLGUI_PROFILE().isDebugEnabled() || qEnvironmentVariableIsSet("KXMLGUI_TRACE_FILE")) ? 1 : 0;
+        // unless another thread or setEnabled() was first
+        if (!s_enabled.testAndSetOrdered(-1, enabled)) {
+            enabled = s_enabled.loadAcquire();
+        }
+    }
+    return enabled;
+}
+
+void KXmlGuiProfiler::setEnabled(bool enable)
+{
+    s_recordAlways.storeRelease(enable ? 1 : 0);
+    s_enabled.storeRelease(enable ? 1 : 0);
+}
+
+static QString clientName(const KXMLGUIClient *client)
+{
+    const QString xmlFile = client->xmlFile();
+    if (xmlFile.isEmpty()) {
+        return client->componentName();
+    }
+    return client->componentName() + QLatin1Char('/') + xmlFile.mid(xmlFile.lastIndexOf(QLatin1Char('/')) + 1);
+}
+
+static ThreadState *threadState()
+{
+    if (!s_threadStates.hasLocalData()) {
+        s_threadStates.setLocalData(new ThreadState);
+    }
+    return s_threadStates.localData();
+}
+
+void KXmlGuiProfiler::Phase::begin(const KXMLGUIClient *client)
+{
+    ThreadState *state = threadState();
+    ThreadState::Open open;
+    open.name = m_name;
+    if (client) {
+        open.client = clientName(client);
+    } else if (!state->open.isEmpty()) {
+        open.client = state->open.last().client;
+    }
+    state->open.append(open);
+    m_start = s_trace()->clock.nsecsElapsed();
+}
+
+static void logSummary(const TraceEvent &outermost, const QVector<TraceEvent> &events)
+{
+    qCDebug(DEBUG_KXMLGUI_PROFILE, "%s (%s) took %.3f ms", outermost.name,
+            qPrintable(outermost.client), outermost.duration / 1000000.0);
+
+    // total per client and phase, in the order they occurred first
+    QStringList clients;
+    QHash<QString, QVector<QPair<const char *, qint64> > > totals;
+    Q_FOREACH (const TraceEvent &event, events) {
+        if (!totals.contains(event.client)) {
+            clients.append(event.client);
+        }
+        QVector<QPair<const char *, qint64> > &phases = totals[event.client];
+        int i = 0;
+        while (i < phases.count() && qstrcmp(phases.at(i).first, event.name) != 0) {
+            ++i;
+        }
+        if (i == phases.count()) {
+            phases.append(qMakePair(event.name, qint64(0)));
+        }
+        phases[i].second += event.duration;
+    }
+
+    Q_FOREACH (const QString &client, clients) {
+        QString line;
+        typedef QPair<const char *, qint64> PhaseTotal;
+        Q_FOREACH (const PhaseTotal &phase, totals.value(client)) {
+            if (!line.isEmpty()) {
+                line += QLatin1String(", ");
+            }
+            line += QString::fromLatin1("%1 %2 ms").arg(QLatin1String(phase.first)).arg(phase.second / 1000000.0, 0, 'f', 3);
+        }
+        qCDebug(DEBUG_KXMLGUI_PROFILE, "  %s: %s", client.isEmpty() ? "(no client)" : qPrintable(client), qPrintable(line));
+    }
+}
+
+void KXmlGuiProfiler::Phase::end()
+{
+    Trace *trace = s_trace();
+    ThreadState *state = threadState();
+
+    TraceEvent event;
+    event.duration = trace->clock.nsecsElapsed() - m_start;
+    event.start = m_start;
+    event.name = m_name;
+    event.client = state->open.last().client;
+    event.thread = quintptr(QThread::currentThreadId());
+    state->open.removeLast();
+
+    if (s_recordAlways.loadAcquire() || !trace->fileName.isEmpty()) {
+        QMutexLocker locker(&trace->mutex);
+        trace->events.append(event);
+    }
+
+    if (DEBUG_KXMLGUI_PROFILE().isDebugEnabled()) {
+        if (state->open.isEmpty()) {
+            logSummary(event, state->ended);
+            state->ended.clear();
+        } else {
+            state->ended.append(event);
+        }
+    }
+}
+
+QByteArray KXmlGuiProfiler::traceJson()
+{
+    return s_trace()->json();
+}
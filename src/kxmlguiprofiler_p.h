@@ -0,0 +1,92 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef KXMLGUIPROFILER_P_H
+#define KXMLGUIPROFILER_P_H
+
+#include <QByteArray>
+#include <QLoggingCategory>
+
+#include "kxmlgui_tests_export_p.h"
+
+class KXMLGUIClient;
+
+Q_DECLARE_LOGGING_CATEGORY(DEBUG_KXMLGUI_PROFILE)
+
+/**
+ * @internal
+ * Measures how long the phases of loading and building the GUI take, per client.
+ *
+ * Enable the debug output of the kf5.kxmlgui.profile logging category to get a
+ * summary whenever an outermost phase (e.g. adding a client to the factory) ends,
+ * and/or set KXMLGUI_TRACE_FILE to a file which all phases get written to when the
+ * application exits, in the Chrome trace event format (chrome://tracing, Perfetto).
+ *
+ * Both are checked once, when the profiler is used first. When disabled, a Phase
+ * costs one check of a flag.
+ *
+ * Exported for the unit test (only when it's built), which checks what the library records.
+ */
+class KXMLGUI_TESTS_EXPORT KXmlGuiProfiler
+{
+public:
+    static bool isEnabled();
+    /**
+     * Overrides the environment; when enabled this way, the phases are
+     * recorded for traceJson() even without a trace file. Used by the unit test.
+     */
+    static void setEnabled(bool enable);
+
+    /**
+     * Measures the scope it lives in. Phases nested in a phase of a client, in
+     * the same thread, count for that client as well.
+     */
+    class Phase
+    {
+    public:
+        explicit Phase(const char *name, const KXMLGUIClient *client = nullptr)
+            : m_name(name), m_start(-1)
+        {
+            if (isEnabled()) {
+                begin(client);
+            }
+        }
+        ~Phase()
+        {
+            if (m_start >= 0) {
+                end();
+            }
+        }
+
+    private:
+        void begin(const KXMLGUIClient *client);
+        void end();
+
+        const char *const m_name;
+        qint64 m_start;
+
+        Q_DISABLE_COPY(Phase)
+    };
+
+    /**
+     * The phases recorded so far, in the Chrome trace event format.
+     */
+    static QByteArray traceJson();
+};
+
+#endif /* KXMLGUIPROFILER_P_H */
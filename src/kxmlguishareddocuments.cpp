@@ -0,0 +1,179 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "kxmlguishareddocuments_p.h"
+
+#include <QHash>
+
+namespace {
+struct SharedDocument {
+    QString key;
+    QString componentName;
+    QDomDocument document;
+    QStringList files;
+    int users;
+};
+
+struct SharedDocuments {
+    SharedDocuments() : enabled(false) {}
+
+    // Finds the entry of @p doc, either a current or an invalidated one
+    SharedDocument *find(const QString &key, const QDomDocument &doc)
+    {
+        QHash<QString, SharedDocument>::iterator it = documents.find(key);
+        if (it != documents.end() && it->document == doc) {
+            return &*it;
+        }
+        for (QList<SharedDocument>::iterator oldIt = invalidated.begin(); oldIt != invalidated.end(); ++oldIt) {
+            if (oldIt->document == doc) {
+                return &*oldIt;
+            }
+        }
+        return nullptr;
+    }
+
+    void remove(SharedDocument *shared)
+    {
+        QHash<QString, SharedDocument>::iterator it = documents.find(shared->key);
+        if (it != documents.end() && &*it == shared) {
+            documents.erase(it);
+            return;
+        }
+        for (int i = 0; i < invalidated.count(); ++i) {
+            if (&invalidated[i] == shared) {
+                invalidated.removeAt(i);
+                return;
+            }
+        }
+    }
+
+    bool enabled;
+    QHash<QString, SharedDocument> documents;
+    QList<SharedDocument> invalidated; // still in use
+};
+}
+
+Q_GLOBAL_STATIC(SharedDocuments, s_sharedDocuments)
+
+bool KXmlGuiSharedDocuments::isEnabled()
+{
+    return s_sharedDocuments()->enabled;
+}
+
+void KXmlGuiSharedDocuments::setEnabled(bool enable)
+{
+    s_sharedDocuments()->enabled = enable;
+}
+
+QString KXmlGuiSharedDocuments::key(const QString &componentName, const QStringList &keyData)
+{
+    return componentName + QLatin1Char('\n') + keyData.join(QLatin1Char('\n'));
+}
+
+QDomDocument KXmlGuiSharedDocuments::acquire(const QString &key, QStringList *files)
+{
+    QHash<QString, SharedDocument>::iterator it = s_sharedDocuments()->documents.find(key);
+    if (it == s_sharedDocuments()->documents.end()) {
+        return QDomDocument();
+    }
+    ++it->users;
+    if (files) {
+        *files = it->files;
+    }
+    return it->document;
+}
+
+void KXmlGuiSharedDocuments::insert(const QString &key, const QDomDocument &doc, const QStringList &files)
+{
+    SharedDocuments *shared = s_sharedDocuments();
+    QHash<QString, SharedDocument>::iterator it = shared->documents.find(key);
+    if (it != shared->documents.end()) {
+        // still used by others
+        shared->invalidated.append(*it);
+        shared->documents.erase(it);
+    }
+
+    SharedDocument entry;
+    entry.key = key;
+    entry.componentName = key.left(key.indexOf(QLatin1Char('\n')));
+    entry.document = doc;
+    entry.files = files;
+    entry.users = 1;
+    shared->documents.insert(key, entry);
+}
+
+void KXmlGuiSharedDocuments::release(const QString &key, const QDomDocument &doc)
+{
+    SharedDocument *entry = s_sharedDocuments()->find(key, doc);
+    if (entry && --entry->users == 0) {
+        s_sharedDocuments()->remove(entry);
+    }
+}
+
+QDomDocument KXmlGuiSharedDocuments::detach(const QString &key, const QDomDocument &doc)
+{
+    SharedDocument *entry = s_sharedDocuments()->find(key, doc);
+    if (!entry) {
+        return doc;
+    }
+    if (entry->users == 1) {
+        // nobody else uses it, no need for a copy
+        s_sharedDocuments()->remove(entry);
+        return doc;
+    }
+    --entry->users;
+    return doc.cloneNode(true).toDocument();
+}
+
+bool KXmlGuiSharedDocuments::isShared(const QDomDocument &doc)
+{
+    if (doc.isNull()) {
+        return false;
+    }
+    const SharedDocuments *shared = s_sharedDocuments();
+    for (QHash<QString, SharedDocument>::const_iterator it = shared->documents.constBegin(); it != shared->documents.constEnd(); ++it) {
+        if (it->document == doc) {
+            return true;
+        }
+    }
+    for (const SharedDocument &entry : shared->invalidated) {
+        if (entry.document == doc) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void KXmlGuiSharedDocuments::invalidate(const QString &componentName)
+{
+    SharedDocuments *shared = s_sharedDocuments();
+    QHash<QString, SharedDocument>::iterator it = shared->documents.begin();
+    while (it != shared->documents.end()) {
+        if (it->componentName == componentName) {
+            shared->invalidated.append(*it);
+            it = shared->documents.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+int KXmlGuiSharedDocuments::count()
+{
+    return s_sharedDocuments()->documents.count();
+}
@@ -0,0 +1,84 @@
+/* This file is part of the KDE libraries
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef KXMLGUISHAREDDOCUMENTS_P_H
+#define KXMLGUISHAREDDOCUMENTS_P_H
+
+#include <QDomDocument>
+#include <QStringList>
+
+/**
+ * @internal
+ * Documents shared between the clients which loaded the same xml files,
+ * see KXMLGUIClient::setDocumentSharingEnabled.
+ *
+ * A document stays registered as long as a client uses it. Clients copy it
+ * before changing it (e.g. merging another document into it), and it's
+ * unregistered when one of the files of its component is saved.
+ *
+ * Only to be used from the GUI thread.
+ */
+class KXmlGuiSharedDocuments
+{
+public:
+    static bool isEnabled();
+    static void setEnabled(bool enable);
+
+    /**
+     * @param keyData everything the document depends on, e.g. the file name and the translation domain
+     */
+    static QString key(const QString &componentName, const QStringList &keyData);
+
+    /**
+     * Returns the document registered as @p key, and the files it was built from,
+     * and counts the caller as one of its users. Returns a null document if there's none.
+     */
+    static QDomDocument acquire(const QString &key, QStringList *files = nullptr);
+
+    /**
+     * Registers @p doc as @p key, with the caller as its only user.
+     */
+    static void insert(const QString &key, const QDomDocument &doc, const QStringList &files);
+
+    /**
+     * The caller doesn't use @p doc (registered as @p key) anymore.
+     */
+    static void release(const QString &key, const QDomDocument &doc);
+
+    /**
+     * Returns a document the caller can modify instead of @p doc (registered as @p key):
+     * @p doc itself if the caller is its only user, a deep copy otherwise.
+     * Either way the caller doesn't use the registered document anymore.
+     */
+    static QDomDocument detach(const QString &key, const QDomDocument &doc);
+
+    /**
+     * Whether @p doc is registered, i.e. must not be modified.
+     */
+    static bool isShared(const QDomDocument &doc);
+
+    /**
+     * Unregisters the documents of @p componentName, so that they aren't handed out anymore.
+     * Their current users still share them.
+     */
+    static void invalidate(const QString &componentName);
+
+    static int count(); // used by the unit test
+};
+
+#endif /* KXMLGUISHAREDDOCUMENTS_P_H */
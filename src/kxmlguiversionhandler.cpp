@@ -23,15 +23,91 @@
 
 #include "kxmlguifactory.h"
 
+#include <QDateTime>
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QDomDocument>
 #include <QDomElement>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSaveFile>
 #include <QStandardPaths>
+#include <QThreadPool>
+#include <QWaitCondition>
 #include <QMap>
 
-struct DocStruct {
-    QString file;
-    QString data;
+// The version attribute of the toplevel element is usually found within the first few
+// hundred bytes, after the xml declaration, the doctype and maybe a license comment.
+static const qint64 s_versionHeaderSize = 4096;
+
+struct VersionCacheEntry {
+    qint64 size;
+    QDateTime lastModified;
+    QString version;
+};
+
+// Versions of the files probed so far (in any thread), keyed by path
+struct VersionCache {
+    QMutex mutex;
+    QHash<QString, VersionCacheEntry> entries;
+};
+Q_GLOBAL_STATIC(VersionCache, s_versionCache)
+
+// Writes the updated local xml files, one after the other
+struct LocalFileWriter {
+    LocalFileWriter()
+    {
+        pool.setMaxThreadCount(1);
+    }
+    QThreadPool pool;
+    QMutex mutex;
+    QWaitCondition written;
+    QHash<QString, int> pendingFiles; // path -> number of queued writes
+};
+Q_GLOBAL_STATIC(LocalFileWriter, s_localFileWriter)
+
+class LocalFileWriteJob : public QRunnable
+{
+public:
+    // @p document must not be shared with anything else, QDomDocument isn't thread-safe
+    LocalFileWriteJob(const QString &file, const QDomDocument &document)
+        : m_file(file), m_document(document)
+    {
+    }
+
+    void run() override
+    {
+        QSaveFile f(m_file);
+        if (f.open(QIODevice::WriteOnly)) {
+            f.write(m_document.toByteArray());
+            f.commit();
+        }
+
+        LocalFileWriter *writer = s_localFileWriter();
+        QMutexLocker locker(&writer->mutex);
+        if (--writer->pendingFiles[m_file] == 0) {
+            writer->pendingFiles.remove(m_file);
+        }
+        writer->written.wakeAll();
+    }
+
+    static void start(const QString &file, const QDomDocument &document)
+    {
+        LocalFileWriter *writer = s_localFileWriter();
+        const QString path = QDir::cleanPath(file);
+        {
+            QMutexLocker locker(&writer->mutex);
+            ++writer->pendingFiles[path];
+        }
+        writer->pool.start(new LocalFileWriteJob(path, document));
+    }
+
+private:
+    const QString m_file;
+    const QDomDocument m_document;
 };
 
 static QList<QDomElement> extractToolBars(const QDomDocument &doc)
@@ -243,6 +319,61 @@ QString KXmlGuiVersionHandler::findVersionNumber(const QString &xml)
     return QString();
 }
 
+QByteArray KXmlGuiVersionHandler::finalDocumentData() const
+{
+    return m_mergedDocument.isNull() ? m_doc : m_mergedDocument.toByteArray();
+}
+
+void KXmlGuiVersionHandler::waitForPendingWrites()
+{
+    s_localFileWriter()->pool.waitForDone();
+}
+
+void KXmlGuiVersionHandler::waitForPendingWrite(const QString &file)
+{
+    LocalFileWriter *writer = s_localFileWriter();
+    const QString path = QDir::cleanPath(file);
+    QMutexLocker locker(&writer->mutex);
+    while (writer->pendingFiles.contains(path)) {
+        writer->written.wait(&writer->mutex);
+    }
+}
+
+QString KXmlGuiVersionHandler::findVersionNumberInFile(const QString &file)
+{
+    const QFileInfo info(file);
+    const qint64 size = info.size();
+    const QDateTime lastModified = info.lastModified();
+
+    VersionCache *cache = s_versionCache();
+    {
+        QMutexLocker locker(&cache->mutex);
+        QHash<QString, VersionCacheEntry>::const_iterator it = cache->entries.constFind(file);
+        if (it != cache->entries.constEnd() && it->size == size && it->lastModified == lastModified) {
+            return it->version;
+        }
+    }
+
+    QFile f(file);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    QString version = findVersionNumber(QString::fromUtf8(f.read(s_versionHeaderSize)));
+    if (version.isEmpty() && !f.atEnd()) {
+        // unusually long preamble, or the header cut the version in half
+        f.seek(0);
+        version = findVersionNumber(QString::fromUtf8(f.readAll()));
+    }
+
+    VersionCacheEntry entry;
+    entry.size = size;
+    entry.lastModified = lastModified;
+    entry.version = version;
+    QMutexLocker locker(&cache->mutex);
+    cache->entries.insert(file, entry);
+    return version;
+}
+
 KXmlGuiVersionHandler::KXmlGuiVersionHandler(const QStringList &files)
 {
     Q_ASSERT(!files.isEmpty());
@@ -250,28 +381,18 @@ KXmlGuiVersionHandler::KXmlGuiVersionHandler(const QStringList &files)
     if (files.count() == 1) {
         // No need to parse version numbers if there's only one file anyway
         m_file = files.first();
-        m_doc = KXMLGUIFactory::readConfigFile(m_file);
+        m_doc = KXMLGUIFactory::readConfigFileData(m_file);
         return;
     }
 
-    QList<DocStruct> allDocuments;
-
-    Q_FOREACH (const QString &file, files) {
-        DocStruct d;
-        d.file = file;
-        d.data = KXMLGUIFactory::readConfigFile(file);
-        allDocuments.append(d);
-    }
-
-    QList<DocStruct>::iterator best = allDocuments.end();
+    // Only probe the version numbers, and read just the file which wins
+    int best = -1;
     uint bestVersion = 0;
 
-    QList<DocStruct>::iterator docIt = allDocuments.begin();
-    const QList<DocStruct>::iterator docEnd = allDocuments.end();
-    for (; docIt != docEnd; ++docIt) {
-        const QString versionStr = findVersionNumber((*docIt).data);
+    for (int i = 0; i < files.count(); ++i) {
+        const QString versionStr = findVersionNumberInFile(files.at(i));
         if (versionStr.isEmpty()) {
-            //qCDebug(DEBUG_KXMLGUI) << "found no version in" << (*docIt).file;
+            //qCDebug(DEBUG_KXMLGUI) << "found no version in" << files.at(i);
             continue;
         }
 
@@ -280,23 +401,26 @@ KXmlGuiVersionHandler::KXmlGuiVersionHandler(const QStringList &files)
         if (!ok) {
             continue;
         }
-        //qCDebug(DEBUG_KXMLGUI) << "found version" << version << "for" << (*docIt).file;
+        //qCDebug(DEBUG_KXMLGUI) << "found version" << version << "for" << files.at(i);
 
         if (version > bestVersion) {
-            best = docIt;
+            best = i;
             //qCDebug(DEBUG_KXMLGUI) << "best version is now " << version;
             bestVersion = version;
         }
     }
 
-    if (best != docEnd) {
-        if (best != allDocuments.begin()) {
-            QList<DocStruct>::iterator local = allDocuments.begin();
+    if (best != -1) {
+        m_file = files.at(best);
+        m_doc = KXMLGUIFactory::readConfigFileData(m_file);
+
+        if (best != 0) {
+            const QString localFile = files.first();
 
-            if ((*local).file.startsWith(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation))) {
+            if (localFile.startsWith(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation))) {
                 // load the local document and extract the action properties
                 QDomDocument localDocument;
-                localDocument.setContent((*local).data);
+                localDocument.setContent(KXMLGUIFactory::readConfigFileData(localFile));
 
                 const ActionPropertiesMap properties = extractActionProperties(localDocument);
                 const QList<QDomElement> toolbars = extractToolBars(localDocument);
@@ -312,7 +436,7 @@ KXmlGuiVersionHandler::KXmlGuiVersionHandler(const QStringList &files)
                     // now load the global one with the higher version number
                     // into memory
                     QDomDocument document;
-                    document.setContent((*best).data);
+                    document.setContent(m_doc);
                     // and store the properties in there
                     storeActionProperties(document, properties);
                     if (!toolbars.isEmpty()) {
@@ -322,30 +446,25 @@ KXmlGuiVersionHandler::KXmlGuiVersionHandler(const QStringList &files)
                         insertToolBars(document, toolbars);
                     }
 
-                    (*local).data = document.toString();
-                    // make sure we pick up the new local doc, when we return later
-                    best = local;
+                    // make sure we pick up the new local doc, without serializing
+                    // and parsing it again
+                    m_mergedDocument = document;
+                    m_doc.clear();
+                    m_file = localFile;
 
-                    // write out the new version of the local document
-                    QFile f((*local).file);
-                    if (f.open(QIODevice::WriteOnly)) {
-                        const QByteArray utf8data = (*local).data.toUtf8();
-                        f.write(utf8data.constData(), utf8data.length());
-                        f.close();
-                    }
+                    // write out the new version of the local document, off the startup path
+                    // (on a copy, since the caller will modify the merged document)
+                    LocalFileWriteJob::start(localFile, document.cloneNode(true).toDocument());
                 } else {
                     // Move away the outdated local file, to speed things up next time
-                    const QString f = (*local).file;
-                    const QString backup = f + QStringLiteral(".backup");
-                    QFile::rename(f, backup);
+                    const QString backup = localFile + QStringLiteral(".backup");
+                    QFile::rename(localFile, backup);
                 }
             }
         }
-        m_doc = (*best).data;
-        m_file = (*best).file;
     } else {
         //qCDebug(DEBUG_KXMLGUI) << "returning first one...";
-        m_doc = allDocuments.first().data;
-        m_file = allDocuments.first().file;
+        m_file = files.first();
+        m_doc = KXMLGUIFactory::readConfigFileData(m_file);
     }
 }
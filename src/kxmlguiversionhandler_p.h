@@ -22,6 +22,7 @@
 #ifndef KXMLGUIVERSIONHANDLER_P_H
 #define KXMLGUIVERSIONHANDLER_P_H
 
+#include <QDomDocument>
 #include <QStringList>
 
 /**
@@ -46,14 +47,45 @@ public:
     }
     QString finalDocument() const
     {
-        return m_doc;
+        const QByteArray doc = finalDocumentData();
+        return QString::fromUtf8(doc.constData(), doc.size());
     }
+    QByteArray finalDocumentData() const;
+
+    /**
+     * The document resulting from merging the user changes of the local file
+     * into a newer version of the xml file, or a null document if there was
+     * nothing to merge. Use it instead of parsing finalDocumentData() again.
+     *
+     * The updated local file is written in the background, see waitForPendingWrite().
+     */
+    QDomDocument mergedDocument() const
+    {
+        return m_mergedDocument;
+    }
+
+    /**
+     * Blocks until all the local files updated in the background have been written.
+     */
+    static void waitForPendingWrites();
+
+    /**
+     * Blocks until @p file has been written, if it's being updated in the background.
+     */
+    static void waitForPendingWrite(const QString &file);
 
     static QString findVersionNumber(const QString &xml);   // used by the unit test
 
+    /**
+     * Returns the version number of the xml file @p file, reading only the beginning of the file.
+     * The result is cached for as long as the size and modification time of the file don't change.
+     */
+    static QString findVersionNumberInFile(const QString &file);   // used by the unit test
+
 private:
     QString m_file;
-    QString m_doc;
+    QByteArray m_doc;
+    QDomDocument m_mergedDocument;
 };
 
 #endif /* KXMLGUIVERSIONHANDLER_P_H */
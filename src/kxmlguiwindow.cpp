@@ -284,11 +284,9 @@ void KXmlGuiWindow::createGUI(const QString &xmlfile)
                    << "You should call createGUI(" << xmlFile() << ") or setupGUI(<options>," << xmlFile() << ") instead.";
     }
 
-    // we always want to load in our global standards file
-    loadStandardsXmlFile();
-
-    // now, merge in our local xml file.
-    setXMLFile(windowXmlFile, true);
+    // we always want to load in our global standards file,
+    // and then merge in our local xml file (cached, when possible).
+    loadStandardsAndXmlFile(windowXmlFile);
 
     // make sure we don't have any state saved already
     setXMLGUIBuildDocument(QDomDocument());